@@ -0,0 +1,59 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Runs the benchmark against the virtual panel.
+
+$ ./hagl_hal_benchmark [duration_ms]
+
+*/
+
+#include <stdlib.h>
+
+#include <hagl_hal.h>
+#include <hagl.h>
+
+int
+main(int argc, char *argv[])
+{
+    uint32_t duration_ms = 1000;
+
+    if (argc > 1) {
+        duration_ms = strtoul(argv[1], NULL, 10);
+    }
+
+    hagl_backend_t *display = hagl_init();
+    hagl_hal_benchmark(display, duration_ms);
+    hagl_close(display);
+
+    return 0;
+}
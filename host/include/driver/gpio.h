@@ -0,0 +1,31 @@
+/*
+
+Host stand-in for <driver/gpio.h>
+used when building outside of ESP-IDF. Provides only what the MIPI
+DCS HAL needs.
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HOST_DRIVER_GPIO_H
+#define _HOST_DRIVER_GPIO_H
+
+#include <stdint.h>
+#include "esp_err.h"
+typedef int gpio_num_t;
+typedef enum { GPIO_MODE_DISABLE = 0, GPIO_MODE_INPUT = 1, GPIO_MODE_OUTPUT = 2 } gpio_mode_t;
+typedef enum { GPIO_INTR_DISABLE = 0, GPIO_INTR_POSEDGE = 1, GPIO_INTR_NEGEDGE = 2, GPIO_INTR_ANYEDGE = 3 } gpio_int_type_t;
+typedef void (*gpio_isr_t)(void *arg);
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode);
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+int gpio_get_level(gpio_num_t gpio_num);
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type);
+esp_err_t gpio_install_isr_service(int intr_alloc_flags);
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args);
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num);
+
+/* Host only, drives an input pin and runs the handler on a matching edge. */
+void gpio_host_set_input(gpio_num_t gpio_num, uint32_t level);
+
+#endif /* _HOST_DRIVER_GPIO_H */
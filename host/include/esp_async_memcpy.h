@@ -0,0 +1,45 @@
+/*
+
+Host stand-in for <esp_async_memcpy.h>
+used when building outside of ESP-IDF. Provides only what the MIPI
+DCS HAL needs. Copies are done in order by a background thread so
+that a missing wait shows up as a torn blit.
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HOST_ESP_ASYNC_MEMCPY_H
+#define _HOST_ESP_ASYNC_MEMCPY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_idf_version.h"
+
+/* Handle was called async_memcpy_t before ESP-IDF v5.1. */
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+typedef struct async_memcpy_context_t *async_memcpy_handle_t;
+#else
+typedef struct async_memcpy_context_t *async_memcpy_t;
+#endif
+
+typedef struct { void *data; } async_memcpy_event_t;
+typedef bool (*async_memcpy_isr_cb_t)(struct async_memcpy_context_t *mcp_hdl, async_memcpy_event_t *event, void *cb_args);
+
+typedef struct {
+    uint32_t backlog;
+    size_t sram_trans_align;
+    size_t psram_trans_align;
+    int intr_flags;
+    uint32_t flags;
+} async_memcpy_config_t;
+
+#define ASYNC_MEMCPY_DEFAULT_CONFIG() { .backlog = 8 }
+
+esp_err_t esp_async_memcpy_install(const async_memcpy_config_t *config, struct async_memcpy_context_t **mcp);
+esp_err_t esp_async_memcpy_uninstall(struct async_memcpy_context_t *mcp);
+esp_err_t esp_async_memcpy(struct async_memcpy_context_t *mcp, void *dst, void *src, size_t n, async_memcpy_isr_cb_t cb_isr, void *cb_args);
+
+#endif /* _HOST_ESP_ASYNC_MEMCPY_H */
@@ -0,0 +1,17 @@
+/*
+
+Host stand-in for <esp_attr.h>
+used when building outside of ESP-IDF. Provides only what the MIPI
+DCS HAL needs.
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HOST_ESP_ATTR_H
+#define _HOST_ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif /* _HOST_ESP_ATTR_H */
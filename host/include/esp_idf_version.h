@@ -0,0 +1,24 @@
+/*
+
+Host stand-in for <esp_idf_version.h>
+used when building outside of ESP-IDF. Stand-ins follow the ESP-IDF
+v5.x API. Older version can be given with ESP_IDF_VERSION_MAJOR to
+build the compatibility paths.
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HOST_ESP_IDF_VERSION_H
+#define _HOST_ESP_IDF_VERSION_H
+
+#ifndef ESP_IDF_VERSION_MAJOR
+#define ESP_IDF_VERSION_MAJOR 5
+#define ESP_IDF_VERSION_MINOR 1
+#define ESP_IDF_VERSION_PATCH 0
+#endif
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch) ((major << 16) | (minor << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(ESP_IDF_VERSION_MAJOR, ESP_IDF_VERSION_MINOR, ESP_IDF_VERSION_PATCH)
+
+#endif /* _HOST_ESP_IDF_VERSION_H */
@@ -0,0 +1,24 @@
+/*
+
+Host stand-in for <esp_log.h>
+used when building outside of ESP-IDF. Provides only what the MIPI
+DCS HAL needs.
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HOST_ESP_LOG_H
+#define _HOST_ESP_LOG_H
+
+#include <stdio.h>
+#include "esp_err.h"
+typedef enum { ESP_LOG_NONE, ESP_LOG_ERROR, ESP_LOG_WARN, ESP_LOG_INFO, ESP_LOG_DEBUG, ESP_LOG_VERBOSE } esp_log_level_t;
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) do { (void) (tag); } while (0)
+#define ESP_LOGD(tag, fmt, ...) do { (void) (tag); } while (0)
+#define ESP_LOGV(tag, fmt, ...) do { (void) (tag); } while (0)
+#define ESP_LOG_BUFFER_HEX_LEVEL(tag, buffer, length, level) do { (void) (tag); (void) (buffer); (void) (length); } while (0)
+
+#endif /* _HOST_ESP_LOG_H */
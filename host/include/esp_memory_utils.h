@@ -0,0 +1,21 @@
+/*
+
+Host stand-in for <esp_memory_utils.h>
+used when building outside of ESP-IDF. Provides only what the MIPI
+DCS HAL needs. Memory allocated with MALLOC_CAP_SPIRAM is treated as
+external RAM and read only data as flash, DMA cannot read either.
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HOST_ESP_MEMORY_UTILS_H
+#define _HOST_ESP_MEMORY_UTILS_H
+
+#include <stdbool.h>
+
+bool esp_ptr_external_ram(const void *ptr);
+bool esp_ptr_in_drom(const void *ptr);
+bool esp_ptr_dma_capable(const void *ptr);
+
+#endif /* _HOST_ESP_MEMORY_UTILS_H */
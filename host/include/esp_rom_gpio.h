@@ -0,0 +1,17 @@
+/*
+
+Host stand-in for <esp_rom_gpio.h>
+used when building outside of ESP-IDF. Provides only what the MIPI
+DCS HAL needs.
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HOST_ESP_ROM_GPIO_H
+#define _HOST_ESP_ROM_GPIO_H
+
+#include <stdint.h>
+void esp_rom_gpio_pad_select_gpio(uint32_t gpio_num);
+
+#endif /* _HOST_ESP_ROM_GPIO_H */
@@ -0,0 +1,16 @@
+/*
+
+Host stand-in for <esp_system.h>
+used when building outside of ESP-IDF. Provides only what the MIPI
+DCS HAL needs.
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HOST_ESP_SYSTEM_H
+#define _HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+#endif /* _HOST_ESP_SYSTEM_H */
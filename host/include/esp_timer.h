@@ -0,0 +1,19 @@
+/*
+
+Host stand-in for <esp_timer.h>
+used when building outside of ESP-IDF. Provides only what the MIPI
+DCS HAL needs.
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HOST_ESP_TIMER_H
+#define _HOST_ESP_TIMER_H
+
+#include <stdint.h>
+
+/* Microseconds since start of the program. */
+int64_t esp_timer_get_time(void);
+
+#endif /* _HOST_ESP_TIMER_H */
@@ -0,0 +1,15 @@
+/*
+
+Host stand-in for <soc/gpio_struct.h>
+used when building outside of ESP-IDF. Provides only what the MIPI
+DCS HAL needs.
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HOST_SOC_GPIO_STRUCT_H
+#define _HOST_SOC_GPIO_STRUCT_H
+
+
+#endif /* _HOST_SOC_GPIO_STRUCT_H */
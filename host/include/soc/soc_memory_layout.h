@@ -0,0 +1,16 @@
+/*
+
+Host stand-in for <soc/soc_memory_layout.h>
+used when building outside of ESP-IDF. On ESP-IDF v4.x the memory
+region checks are declared here.
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HOST_SOC_MEMORY_LAYOUT_H
+#define _HOST_SOC_MEMORY_LAYOUT_H
+
+#include "esp_memory_utils.h"
+
+#endif /* _HOST_SOC_MEMORY_LAYOUT_H */
@@ -0,0 +1,125 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Virtual MIPI DCS panel used when building outside of ESP-IDF. The SPI
+stand-in decodes the DC line and the DCS byte stream into a virtual
+GRAM and records the traffic which would have been sent to the panel.
+
+*/
+
+#ifndef _VIRTUAL_PANEL_H
+#define _VIRTUAL_PANEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct {
+    /* Number of SPI transactions. */
+    uint32_t transactions;
+    /* Number of DCS command bytes. */
+    uint32_t commands;
+    /* Number of bytes sent, including commands. */
+    uint64_t bytes;
+    /* Number of pixels written to GRAM. */
+    uint64_t pixels;
+    /* Modelled time on the wire at the configured SPI clock speed. */
+    uint64_t wire_ns;
+    /* Transactions sent from PSRAM or flash, real driver would copy them first. */
+    uint32_t external;
+    /* Number of memory write commands, one per address window sent. */
+    uint32_t memory_writes;
+    /* Commands the controller would not accept, bad parameters or QSPI framing. */
+    uint32_t invalid;
+} virtual_panel_stats_t;
+
+void virtual_panel_get_stats(virtual_panel_stats_t *stats);
+void virtual_panel_reset_stats(void);
+
+/**
+ * Set the modelled per transaction overhead in nanoseconds
+ */
+void virtual_panel_set_transaction_overhead(uint32_t ns);
+
+uint8_t virtual_panel_get_address_mode(void);
+uint8_t virtual_panel_get_pixel_format(void);
+
+bool virtual_panel_get_tear_on(void);
+uint16_t virtual_panel_get_tear_scanline(void);
+
+/**
+ * Set the line currently being scanned, returned by GET_SCANLINE
+ */
+void virtual_panel_set_scanline(uint16_t scanline);
+
+/**
+ * Simulate the panel reaching the tear scanline
+ *
+ * Pulses the TE pin if tearing effect output is on. Returns true if the
+ * pulse was sent.
+ */
+bool virtual_panel_te_pulse(void);
+
+/**
+ * Get the address window of the last memory write in GRAM coordinates
+ */
+void virtual_panel_get_window(uint16_t *xs, uint16_t *ys, uint16_t *xe, uint16_t *ye);
+
+/**
+ * Return the GRAM line shown first in the vertical scrolling area
+ */
+uint16_t virtual_panel_get_scroll_start(void);
+
+/**
+ * Get the top fixed and vertical scrolling areas in GRAM lines
+ */
+void virtual_panel_get_scroll_area(uint16_t *tfa, uint16_t *vsa);
+
+/**
+ * Return the pixel shown at given display coordinates as 0xRRGGBB
+ */
+uint32_t virtual_panel_get_pixel(uint16_t x0, uint16_t y0);
+
+/**
+ * Write the visible part of the GRAM to a binary PPM file
+ */
+int virtual_panel_dump_ppm(const char *filename);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _VIRTUAL_PANEL_H */
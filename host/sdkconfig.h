@@ -0,0 +1,251 @@
+/*
+
+Default configuration used when building outside of ESP-IDF. Matches a
+320x240 RGB565 ILI9341 panel. Any of the values can be overridden from
+the compiler command line, for example -DCONFIG_MIPI_DISPLAY_WIDTH=240.
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HOST_SDKCONFIG_H
+#define _HOST_SDKCONFIG_H
+
+#ifndef CONFIG_IDF_TARGET_LINUX
+#define CONFIG_IDF_TARGET_LINUX 1
+#endif
+
+#ifndef CONFIG_MIPI_DCS_ADDRESS_MODE_MIRROR_Y
+#define CONFIG_MIPI_DCS_ADDRESS_MODE_MIRROR_Y 0x00
+#endif
+#ifndef CONFIG_MIPI_DCS_ADDRESS_MODE_MIRROR_X
+#define CONFIG_MIPI_DCS_ADDRESS_MODE_MIRROR_X 0x00
+#endif
+#ifndef CONFIG_MIPI_DCS_ADDRESS_MODE_SWAP_XY
+#define CONFIG_MIPI_DCS_ADDRESS_MODE_SWAP_XY 0x00
+#endif
+#ifndef CONFIG_MIPI_DCS_ADDRESS_MODE_FLIP_X
+#define CONFIG_MIPI_DCS_ADDRESS_MODE_FLIP_X 0x00
+#endif
+#ifndef CONFIG_MIPI_DCS_ADDRESS_MODE_FLIP_Y
+#define CONFIG_MIPI_DCS_ADDRESS_MODE_FLIP_Y 0x00
+#endif
+#ifndef CONFIG_MIPI_DCS_ADDRESS_MODE_BGR
+#define CONFIG_MIPI_DCS_ADDRESS_MODE_BGR 0x00
+#endif
+
+#if !defined(CONFIG_MIPI_DCS_PIXEL_FORMAT_24BIT_SELECTED) && \
+    !defined(CONFIG_MIPI_DCS_PIXEL_FORMAT_18BIT_SELECTED) && \
+    !defined(CONFIG_MIPI_DCS_PIXEL_FORMAT_12BIT_SELECTED) && \
+    !defined(CONFIG_MIPI_DCS_PIXEL_FORMAT_8BIT_SELECTED) && \
+    !defined(CONFIG_MIPI_DCS_PIXEL_FORMAT_3BIT_SELECTED)
+#ifndef CONFIG_MIPI_DCS_PIXEL_FORMAT_16BIT_SELECTED
+#define CONFIG_MIPI_DCS_PIXEL_FORMAT_16BIT_SELECTED 1
+#endif
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIXEL_FORMAT
+#define CONFIG_MIPI_DISPLAY_PIXEL_FORMAT 0x55
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_DEPTH
+#define CONFIG_MIPI_DISPLAY_DEPTH 16
+#endif
+
+#if !defined(CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING) && \
+    !defined(CONFIG_HAGL_HAL_USE_TRIPLE_BUFFERING) && \
+    !defined(CONFIG_HAGL_HAL_USE_STRIP_BUFFERING) && \
+    !defined(CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING) && \
+    !defined(CONFIG_HAGL_HAL_USE_TILED_BUFFERING)
+#ifndef CONFIG_HAGL_HAL_NO_BUFFERING
+#define CONFIG_HAGL_HAL_NO_BUFFERING 1
+#endif
+#endif
+
+#ifndef CONFIG_HAGL_HAL_MAX_DISPLAYS
+#define CONFIG_HAGL_HAL_MAX_DISPLAYS 1
+#endif
+#ifndef CONFIG_HAGL_HAL_DIRTY_RECTANGLES_MAX
+#define CONFIG_HAGL_HAL_DIRTY_RECTANGLES_MAX 8
+#endif
+#ifndef CONFIG_HAGL_HAL_SNAPSHOT_LINES
+#define CONFIG_HAGL_HAL_SNAPSHOT_LINES 8
+#endif
+#ifndef CONFIG_HAGL_HAL_DAMAGE_RECTANGLES_MAX
+#define CONFIG_HAGL_HAL_DAMAGE_RECTANGLES_MAX 8
+#endif
+#ifndef CONFIG_HAGL_HAL_FLUSH_TASK_CORE
+#define CONFIG_HAGL_HAL_FLUSH_TASK_CORE -1
+#endif
+#ifndef CONFIG_HAGL_HAL_FLUSH_TASK_PRIORITY
+#define CONFIG_HAGL_HAL_FLUSH_TASK_PRIORITY 5
+#endif
+#ifndef CONFIG_HAGL_HAL_FLUSH_TASK_STACK_SIZE
+#define CONFIG_HAGL_HAL_FLUSH_TASK_STACK_SIZE 4096
+#endif
+#ifndef CONFIG_HAGL_HAL_INDEXED_BOUNCE_LINES
+#define CONFIG_HAGL_HAL_INDEXED_BOUNCE_LINES 8
+#endif
+#ifndef CONFIG_HAGL_HAL_STRIP_HEIGHT
+#define CONFIG_HAGL_HAL_STRIP_HEIGHT 16
+#endif
+#ifndef CONFIG_HAGL_HAL_TILE_WIDTH
+#define CONFIG_HAGL_HAL_TILE_WIDTH 64
+#endif
+#ifndef CONFIG_HAGL_HAL_TILE_HEIGHT
+#define CONFIG_HAGL_HAL_TILE_HEIGHT 32
+#endif
+#ifndef CONFIG_HAGL_HAL_DMA_BLIT_MIN_SIZE
+#define CONFIG_HAGL_HAL_DMA_BLIT_MIN_SIZE 512
+#endif
+#ifndef CONFIG_HAGL_HAL_DISPLAY_LIST_SIZE
+#define CONFIG_HAGL_HAL_DISPLAY_LIST_SIZE 16384
+#endif
+
+#ifndef CONFIG_HAGL_HAL_BENCHMARK
+#define CONFIG_HAGL_HAL_BENCHMARK 1
+#endif
+
+#ifndef CONFIG_MIPI_DISPLAY_WIDTH
+#define CONFIG_MIPI_DISPLAY_WIDTH 320
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_HEIGHT
+#define CONFIG_MIPI_DISPLAY_HEIGHT 240
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_OFFSET_X
+#define CONFIG_MIPI_DISPLAY_OFFSET_X 0
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_OFFSET_Y
+#define CONFIG_MIPI_DISPLAY_OFFSET_Y 0
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_GRAM_HEIGHT
+#define CONFIG_MIPI_DISPLAY_GRAM_HEIGHT (CONFIG_MIPI_DISPLAY_HEIGHT + CONFIG_MIPI_DISPLAY_OFFSET_Y)
+#endif
+
+#ifndef CONFIG_MIPI_DISPLAY_TRANSPORT_I80
+#ifndef CONFIG_MIPI_DISPLAY_TRANSPORT_SPI
+#define CONFIG_MIPI_DISPLAY_TRANSPORT_SPI 1
+#endif
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_I80_CLOCK_SPEED_HZ
+#define CONFIG_MIPI_DISPLAY_I80_CLOCK_SPEED_HZ 10000000
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_I80_BUS_WIDTH
+#define CONFIG_MIPI_DISPLAY_I80_BUS_WIDTH 8
+#endif
+
+#ifndef CONFIG_MIPI_DISPLAY_SPI_CLOCK_SPEED_HZ
+#define CONFIG_MIPI_DISPLAY_SPI_CLOCK_SPEED_HZ 40000000
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_BOUNCE_SIZE
+#if defined(CONFIG_HAGL_HAL_BACK_BUFFER_PSRAM)
+#define CONFIG_MIPI_DISPLAY_BOUNCE_SIZE 8192
+#elif defined(CONFIG_HAGL_HAL_NO_BUFFERING)
+#define CONFIG_MIPI_DISPLAY_BOUNCE_SIZE 4096
+#else
+#define CONFIG_MIPI_DISPLAY_BOUNCE_SIZE 0
+#endif
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_SPI_MODE
+#define CONFIG_MIPI_DISPLAY_SPI_MODE 0
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_SPI_HOST
+#define CONFIG_MIPI_DISPLAY_SPI_HOST 0x01
+#endif
+
+#ifndef CONFIG_MIPI_DISPLAY_PIN_MISO
+#define CONFIG_MIPI_DISPLAY_PIN_MISO -1
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_MOSI
+#define CONFIG_MIPI_DISPLAY_PIN_MOSI 23
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_CLK
+#define CONFIG_MIPI_DISPLAY_PIN_CLK 18
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_QUADWP
+#define CONFIG_MIPI_DISPLAY_PIN_QUADWP 16
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_QUADHD
+#define CONFIG_MIPI_DISPLAY_PIN_QUADHD 17
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_WR
+#define CONFIG_MIPI_DISPLAY_PIN_WR 8
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_RD
+#define CONFIG_MIPI_DISPLAY_PIN_RD 9
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D0
+#define CONFIG_MIPI_DISPLAY_PIN_D0 39
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D1
+#define CONFIG_MIPI_DISPLAY_PIN_D1 40
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D2
+#define CONFIG_MIPI_DISPLAY_PIN_D2 41
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D3
+#define CONFIG_MIPI_DISPLAY_PIN_D3 42
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D4
+#define CONFIG_MIPI_DISPLAY_PIN_D4 45
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D5
+#define CONFIG_MIPI_DISPLAY_PIN_D5 46
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D6
+#define CONFIG_MIPI_DISPLAY_PIN_D6 47
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D7
+#define CONFIG_MIPI_DISPLAY_PIN_D7 48
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D8
+#define CONFIG_MIPI_DISPLAY_PIN_D8 -1
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D9
+#define CONFIG_MIPI_DISPLAY_PIN_D9 -1
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D10
+#define CONFIG_MIPI_DISPLAY_PIN_D10 -1
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D11
+#define CONFIG_MIPI_DISPLAY_PIN_D11 -1
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D12
+#define CONFIG_MIPI_DISPLAY_PIN_D12 -1
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D13
+#define CONFIG_MIPI_DISPLAY_PIN_D13 -1
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D14
+#define CONFIG_MIPI_DISPLAY_PIN_D14 -1
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_D15
+#define CONFIG_MIPI_DISPLAY_PIN_D15 -1
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_CS
+#define CONFIG_MIPI_DISPLAY_PIN_CS 14
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_DC
+#define CONFIG_MIPI_DISPLAY_PIN_DC 27
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_RST
+#define CONFIG_MIPI_DISPLAY_PIN_RST 33
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_BL
+#define CONFIG_MIPI_DISPLAY_PIN_BL 32
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_TE
+#define CONFIG_MIPI_DISPLAY_PIN_TE -1
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_TE_SCANLINE
+#define CONFIG_MIPI_DISPLAY_TE_SCANLINE 0
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_REFRESH_RATE
+#define CONFIG_MIPI_DISPLAY_REFRESH_RATE 60
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PIN_BL_ACTIVE
+#define CONFIG_MIPI_DISPLAY_PIN_BL_ACTIVE 1
+#endif
+#ifndef CONFIG_MIPI_DISPLAY_PWM_BL
+#define CONFIG_MIPI_DISPLAY_PWM_BL -1
+#endif
+
+#endif /* _HOST_SDKCONFIG_H */
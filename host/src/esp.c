@@ -0,0 +1,355 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Heap, timer, GPIO, LEDC and async memcpy stand-ins. GPIO levels are
+stored so that the virtual panel can sample the DC line. Blocks allocated
+from PSRAM are remembered so that they can be told apart from DMA capable
+memory. Read only data of the executable stands in for flash mapped with
+esp_partition_mmap(), DMA cannot read it either. Async copies are done by a thread in the order they were queued.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+#include "esp_timer.h"
+#include "esp_async_memcpy.h"
+#include "esp_rom_gpio.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+
+#define GPIO_COUNT  (64)
+#define SPIRAM_BLOCKS   (16)
+
+static uint32_t levels[GPIO_COUNT];
+static gpio_int_type_t intr_types[GPIO_COUNT];
+static gpio_isr_t handlers[GPIO_COUNT];
+static void *handler_args[GPIO_COUNT];
+
+static struct {
+    const uint8_t *start;
+    size_t size;
+} spiram[SPIRAM_BLOCKS];
+
+void *
+heap_caps_malloc(size_t size, uint32_t caps)
+{
+    void *ptr = malloc(size);
+
+    if (ptr && (caps & MALLOC_CAP_SPIRAM)) {
+        for (size_t i = 0; i < SPIRAM_BLOCKS; i++) {
+            if (NULL == spiram[i].start) {
+                spiram[i].start = ptr;
+                spiram[i].size = size;
+                break;
+            }
+        }
+    }
+    return ptr;
+}
+
+void *
+heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    return calloc(n, size);
+}
+
+void *
+heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps)
+{
+    /* Size must be a multiple of alignment for aligned_alloc(). */
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void
+heap_caps_free(void *ptr)
+{
+    for (size_t i = 0; ptr && i < SPIRAM_BLOCKS; i++) {
+        if (ptr == spiram[i].start) {
+            spiram[i].start = NULL;
+        }
+    }
+    free(ptr);
+}
+
+bool
+esp_ptr_external_ram(const void *ptr)
+{
+    const uint8_t *p = ptr;
+
+    for (size_t i = 0; i < SPIRAM_BLOCKS; i++) {
+        if (spiram[i].start && p >= spiram[i].start && p < spiram[i].start + spiram[i].size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Between the end of code and the start of writable data. */
+extern const char etext[];
+extern const char __data_start[];
+
+bool
+esp_ptr_in_drom(const void *ptr)
+{
+    const char *p = ptr;
+
+    return p >= etext && p < __data_start;
+}
+
+bool
+esp_ptr_dma_capable(const void *ptr)
+{
+    return !esp_ptr_external_ram(ptr) && !esp_ptr_in_drom(ptr);
+}
+
+size_t
+heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return 0;
+}
+
+size_t
+heap_caps_get_free_size(uint32_t caps)
+{
+    return 0;
+}
+
+void
+heap_caps_print_heap_info(uint32_t caps)
+{
+}
+
+int64_t
+esp_timer_get_time(void)
+{
+    static int64_t start = 0;
+    struct timespec ts;
+    int64_t now;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (0 == start) {
+        start = now;
+    }
+    return now - start;
+}
+
+void
+esp_rom_gpio_pad_select_gpio(uint32_t gpio_num)
+{
+}
+
+esp_err_t
+gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t
+gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    levels[gpio_num] = level;
+    return ESP_OK;
+}
+
+int
+gpio_get_level(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_COUNT) {
+        return 0;
+    }
+    return levels[gpio_num];
+}
+
+esp_err_t
+gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    intr_types[gpio_num] = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t
+gpio_install_isr_service(int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t
+gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handlers[gpio_num] = isr_handler;
+    handler_args[gpio_num] = args;
+    return ESP_OK;
+}
+
+esp_err_t
+gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    return gpio_isr_handler_add(gpio_num, NULL, NULL);
+}
+
+void
+gpio_host_set_input(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_COUNT) {
+        return;
+    }
+
+    uint32_t previous = levels[gpio_num];
+    gpio_int_type_t type = intr_types[gpio_num];
+    levels[gpio_num] = level;
+
+    if (NULL == handlers[gpio_num] || previous == level) {
+        return;
+    }
+    if ((level && (type & GPIO_INTR_POSEDGE)) || (!level && (type & GPIO_INTR_NEGEDGE))) {
+        handlers[gpio_num](handler_args[gpio_num]);
+    }
+}
+
+esp_err_t
+ledc_timer_config(const ledc_timer_config_t *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t
+ledc_channel_config(const ledc_channel_config_t *config)
+{
+    return ESP_OK;
+}
+
+struct async_memcpy_context_t {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t backlog;
+    uint32_t head;
+    uint32_t tail;
+    struct {
+        void *dst;
+        void *src;
+        size_t n;
+        async_memcpy_isr_cb_t cb;
+        void *args;
+    } *copies;
+};
+
+static void *
+async_memcpy_main(void *arg)
+{
+    struct async_memcpy_context_t *mcp = arg;
+
+    pthread_mutex_lock(&mcp->lock);
+    while (1) {
+        while (mcp->head == mcp->tail) {
+            pthread_cond_wait(&mcp->cond, &mcp->lock);
+        }
+        const uint32_t i = mcp->tail % mcp->backlog;
+        pthread_mutex_unlock(&mcp->lock);
+
+        memcpy(mcp->copies[i].dst, mcp->copies[i].src, mcp->copies[i].n);
+
+        /* Slot is free again before the callback like on hardware. */
+        pthread_mutex_lock(&mcp->lock);
+        const async_memcpy_isr_cb_t cb = mcp->copies[i].cb;
+        void *args = mcp->copies[i].args;
+        mcp->tail++;
+        pthread_mutex_unlock(&mcp->lock);
+
+        if (cb) {
+            cb(mcp, NULL, args);
+        }
+        pthread_mutex_lock(&mcp->lock);
+    }
+    return NULL;
+}
+
+esp_err_t
+esp_async_memcpy_install(const async_memcpy_config_t *config, struct async_memcpy_context_t **mcp)
+{
+    struct async_memcpy_context_t *ctx = calloc(1, sizeof(struct async_memcpy_context_t));
+
+    ctx->backlog = config->backlog;
+    ctx->copies = calloc(config->backlog, sizeof(*ctx->copies));
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->cond, NULL);
+    pthread_create(&ctx->thread, NULL, async_memcpy_main, ctx);
+    pthread_detach(ctx->thread);
+
+    *mcp = ctx;
+    return ESP_OK;
+}
+
+esp_err_t
+esp_async_memcpy_uninstall(struct async_memcpy_context_t *mcp)
+{
+    /* Thread keeps running, the HAL never uninstalls. */
+    return ESP_OK;
+}
+
+esp_err_t
+esp_async_memcpy(struct async_memcpy_context_t *mcp, void *dst, void *src, size_t n, async_memcpy_isr_cb_t cb_isr, void *cb_args)
+{
+    pthread_mutex_lock(&mcp->lock);
+    if (mcp->head - mcp->tail == mcp->backlog) {
+        pthread_mutex_unlock(&mcp->lock);
+        return ESP_FAIL;
+    }
+
+    const uint32_t i = mcp->head % mcp->backlog;
+    mcp->copies[i].dst = dst;
+    mcp->copies[i].src = src;
+    mcp->copies[i].n = n;
+    mcp->copies[i].cb = cb_isr;
+    mcp->copies[i].args = cb_args;
+    mcp->head++;
+
+    pthread_cond_signal(&mcp->cond);
+    pthread_mutex_unlock(&mcp->lock);
+    return ESP_OK;
+}
@@ -0,0 +1,327 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+FreeRTOS queues, semaphores and tasks on top of POSIX threads. Semaphores
+are queues with zero sized items just like in FreeRTOS itself.
+
+*/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *items;
+};
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+};
+
+static pthread_mutex_t critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+static void
+deadline(TickType_t ticks, struct timespec *ts)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ticks / 1000;
+    ts->tv_nsec += (ticks % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec += 1;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+/* Wait until condition changes. Returns pdFALSE on timeout. */
+static BaseType_t
+wait(QueueHandle_t q, TickType_t ticks, const struct timespec *ts)
+{
+    if (0 == ticks) {
+        return pdFALSE;
+    }
+    if (portMAX_DELAY == ticks) {
+        pthread_cond_wait(&q->changed, &q->lock);
+        return pdTRUE;
+    }
+    if (ETIMEDOUT == pthread_cond_timedwait(&q->changed, &q->lock, ts)) {
+        return pdFALSE;
+    }
+    return pdTRUE;
+}
+
+QueueHandle_t
+xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t q = calloc(1, sizeof(struct host_queue));
+
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    q->length = length;
+    q->item_size = item_size;
+    if (item_size) {
+        q->items = calloc(length, item_size);
+    }
+    return q;
+}
+
+static BaseType_t
+send(QueueHandle_t q, const void *item, TickType_t ticks, bool overwrite)
+{
+    struct timespec ts;
+
+    deadline(ticks, &ts);
+    pthread_mutex_lock(&q->lock);
+
+    while (q->count == q->length && !overwrite) {
+        if (pdFALSE == wait(q, ticks, &ts)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+
+    if (q->count == q->length) {
+        /* Only single item queues can be overwritten. */
+        q->count = 0;
+    }
+
+    if (q->item_size) {
+        UBaseType_t tail = (q->head + q->count) % q->length;
+        memcpy(q->items + tail * q->item_size, item, q->item_size);
+    }
+    q->count++;
+
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t
+xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    return send(q, item, ticks, false);
+}
+
+BaseType_t
+xQueueOverwrite(QueueHandle_t q, const void *item)
+{
+    return send(q, item, 0, true);
+}
+
+BaseType_t
+xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *woken)
+{
+    if (woken) {
+        *woken = pdFALSE;
+    }
+    return send(q, item, 0, false);
+}
+
+BaseType_t
+xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    struct timespec ts;
+
+    deadline(ticks, &ts);
+    pthread_mutex_lock(&q->lock);
+
+    while (0 == q->count) {
+        if (pdFALSE == wait(q, ticks, &ts)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+
+    if (q->item_size) {
+        memcpy(item, q->items + q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->length;
+    }
+    q->count--;
+
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+UBaseType_t
+uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    UBaseType_t count;
+
+    pthread_mutex_lock(&q->lock);
+    count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+void
+vQueueDelete(QueueHandle_t q)
+{
+    pthread_cond_destroy(&q->changed);
+    pthread_mutex_destroy(&q->lock);
+    free(q->items);
+    free(q);
+}
+
+SemaphoreHandle_t
+xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    SemaphoreHandle_t s = xQueueCreate(max, 0);
+    s->count = initial;
+    return s;
+}
+
+SemaphoreHandle_t
+xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t
+xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t
+xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks)
+{
+    return xQueueReceive(s, NULL, ticks);
+}
+
+BaseType_t
+xSemaphoreGive(SemaphoreHandle_t s)
+{
+    return xQueueSend(s, NULL, 0);
+}
+
+BaseType_t
+xSemaphoreGiveFromISR(SemaphoreHandle_t s, BaseType_t *woken)
+{
+    return xQueueSendFromISR(s, NULL, woken);
+}
+
+void
+vSemaphoreDelete(SemaphoreHandle_t s)
+{
+    vQueueDelete(s);
+}
+
+static void *
+task_main(void *arg)
+{
+    TaskHandle_t task = arg;
+    task->fn(task->arg);
+    return NULL;
+}
+
+BaseType_t
+xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+    TaskHandle_t task = calloc(1, sizeof(struct host_task));
+
+    task->fn = fn;
+    task->arg = arg;
+    if (0 != pthread_create(&task->thread, NULL, task_main, task)) {
+        free(task);
+        return pdFALSE;
+    }
+    pthread_detach(task->thread);
+
+    if (handle) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t
+xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, handle, tskNO_AFFINITY);
+}
+
+void
+vTaskDelete(TaskHandle_t handle)
+{
+    if (NULL == handle) {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(handle->thread);
+}
+
+void
+vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = ticks / 1000,
+        .tv_nsec = (ticks % 1000) * 1000000L,
+    };
+    nanosleep(&ts, NULL);
+}
+
+TickType_t
+xTaskGetTickCount(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void
+portENTER_CRITICAL(portMUX_TYPE *mux)
+{
+    pthread_mutex_lock(&critical);
+}
+
+void
+portEXIT_CRITICAL(portMUX_TYPE *mux)
+{
+    pthread_mutex_unlock(&critical);
+}
@@ -0,0 +1,702 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+SPI master stand-in and the virtual panel behind it. Transactions are
+executed immediately when transmitted or queued. Level of the DC pin
+decides whether the bytes are DCS commands or data. With QSPI framing
+the command is taken from the address phase instead. The esp_lcd i80
+stand-in passes the command and the data following it separately and
+calls the color done callback right away. Address window,
+address mode and pixel format are tracked and pixel data is written to
+a virtual GRAM which can be dumped as a PPM image.
+
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "sdkconfig.h"
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_memory_utils.h"
+#include "mipi_dcs.h"
+#include "virtual_panel.h"
+
+#define GRAM_WIDTH  (CONFIG_MIPI_DISPLAY_WIDTH + CONFIG_MIPI_DISPLAY_OFFSET_X)
+#define GRAM_HEIGHT (CONFIG_MIPI_DISPLAY_GRAM_HEIGHT)
+
+/* QSPI panels expect pixel data with this opcode. */
+#define QSPI_OPCODE_WRITE_COLOR (0x32)
+
+struct spi_device_t {
+    spi_device_interface_config_t config;
+    spi_transaction_t **results;
+    size_t head;
+    size_t count;
+};
+
+struct esp_lcd_i80_bus_t {
+    esp_lcd_i80_bus_config_t config;
+};
+
+struct esp_lcd_panel_io_t {
+    esp_lcd_i80_bus_handle_t bus;
+    esp_lcd_panel_io_i80_config_t config;
+};
+
+static struct {
+    uint8_t command;
+    uint8_t params[16];
+    size_t count;
+    uint16_t xs, xe, ys, ye;
+    uint16_t x, y;
+    uint8_t address_mode;
+    uint8_t pixel_format;
+    bool tear_on;
+    uint16_t tear_scanline;
+    uint16_t scanline;
+    uint16_t tfa, vsa, vsp;
+    uint16_t sr, er;
+    bool partial;
+    bool idle;
+    uint8_t pixel[3];
+    uint8_t pixel_count;
+    uint32_t gram[GRAM_WIDTH * GRAM_HEIGHT];
+} panel = {
+    .xe = GRAM_WIDTH - 1,
+    .ye = GRAM_HEIGHT - 1,
+    .vsa = GRAM_HEIGHT,
+    .er = GRAM_HEIGHT - 1,
+    .pixel_format = CONFIG_MIPI_DISPLAY_PIXEL_FORMAT,
+};
+
+static virtual_panel_stats_t stats;
+static uint32_t overhead_ns = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+gram_write(uint32_t rgb)
+{
+    if (panel.x < GRAM_WIDTH && panel.y < GRAM_HEIGHT) {
+        panel.gram[panel.y * GRAM_WIDTH + panel.x] = rgb;
+    }
+    stats.pixels++;
+
+    /* Advance column first, then page, wrapping inside the window. */
+    if (++panel.x > panel.xe) {
+        panel.x = panel.xs;
+        if (++panel.y > panel.ye) {
+            panel.y = panel.ys;
+        }
+    }
+}
+
+static uint32_t
+rgb(uint8_t r, uint8_t g, uint8_t b)
+{
+    return (r << 16) | (g << 8) | b;
+}
+
+static void
+pixel_data(uint8_t byte)
+{
+    uint8_t *p = panel.pixel;
+
+    p[panel.pixel_count++] = byte;
+
+    switch (panel.pixel_format & 0x07) {
+        case 0x07: /* 24 bit */
+        case 0x06: /* 18 bit, six upper bits of each byte */
+            if (3 == panel.pixel_count) {
+                gram_write(rgb(p[0], p[1], p[2]));
+                panel.pixel_count = 0;
+            }
+            break;
+        case 0x05: /* 16 bit RGB565 */
+            if (2 == panel.pixel_count) {
+                uint16_t c = (p[0] << 8) | p[1];
+                gram_write(rgb((c >> 11) << 3, ((c >> 5) & 0x3f) << 2, (c & 0x1f) << 3));
+                panel.pixel_count = 0;
+            }
+            break;
+        case 0x03: /* 12 bit RGB444, two pixels in three bytes */
+            if (3 == panel.pixel_count) {
+                gram_write(rgb(p[0] & 0xf0, (p[0] << 4) & 0xf0, p[1] & 0xf0));
+                gram_write(rgb((p[1] << 4) & 0xf0, p[2] & 0xf0, (p[2] << 4) & 0xf0));
+                panel.pixel_count = 0;
+            }
+            break;
+        case 0x02: /* 8 bit RGB332 */
+            gram_write(rgb(p[0] & 0xe0, (p[0] << 3) & 0xe0, (p[0] << 6) & 0xc0));
+            panel.pixel_count = 0;
+            break;
+        case 0x01: /* 3 bit RGB111, two pixels in one byte */
+            gram_write(rgb((p[0] & 0x20) ? 0xff : 0, (p[0] & 0x10) ? 0xff : 0, (p[0] & 0x08) ? 0xff : 0));
+            gram_write(rgb((p[0] & 0x04) ? 0xff : 0, (p[0] & 0x02) ? 0xff : 0, (p[0] & 0x01) ? 0xff : 0));
+            panel.pixel_count = 0;
+            break;
+        default:
+            panel.pixel_count = 0;
+    }
+}
+
+static void
+panel_command(uint8_t command)
+{
+    panel.command = command;
+    panel.count = 0;
+    panel.pixel_count = 0;
+
+    if (MIPI_DCS_WRITE_MEMORY_START == command) {
+        panel.x = panel.xs;
+        panel.y = panel.ys;
+        stats.memory_writes++;
+    }
+    if (MIPI_DCS_SET_TEAR_OFF == command) {
+        panel.tear_on = false;
+    }
+    if (MIPI_DCS_ENTER_PARTIAL_MODE == command) {
+        panel.partial = true;
+    }
+    if (MIPI_DCS_ENTER_NORMAL_MODE == command) {
+        panel.partial = false;
+    }
+    if (MIPI_DCS_ENTER_IDLE_MODE == command || MIPI_DCS_EXIT_IDLE_MODE == command) {
+        panel.idle = (MIPI_DCS_ENTER_IDLE_MODE == command);
+    }
+}
+
+static void
+panel_data(uint8_t byte)
+{
+    if (panel.count < sizeof(panel.params)) {
+        panel.params[panel.count] = byte;
+    }
+    panel.count++;
+
+    switch (panel.command) {
+        case MIPI_DCS_SET_COLUMN_ADDRESS:
+            if (4 == panel.count) {
+                panel.xs = (panel.params[0] << 8) | panel.params[1];
+                panel.xe = (panel.params[2] << 8) | panel.params[3];
+            }
+            break;
+        case MIPI_DCS_SET_PAGE_ADDRESS:
+            if (4 == panel.count) {
+                panel.ys = (panel.params[0] << 8) | panel.params[1];
+                panel.ye = (panel.params[2] << 8) | panel.params[3];
+            }
+            break;
+        case MIPI_DCS_SET_ADDRESS_MODE:
+            panel.address_mode = byte;
+            break;
+        case MIPI_DCS_SET_PIXEL_FORMAT:
+            panel.pixel_format = byte;
+            break;
+        case MIPI_DCS_SET_TEAR_ON:
+            panel.tear_on = true;
+            break;
+        case MIPI_DCS_SET_TEAR_SCANLINE:
+            if (2 == panel.count) {
+                panel.tear_scanline = (panel.params[0] << 8) | panel.params[1];
+            }
+            break;
+        case MIPI_DCS_SET_PARTIAL_ROWS:
+            if (4 == panel.count) {
+                panel.sr = (panel.params[0] << 8) | panel.params[1];
+                panel.er = (panel.params[2] << 8) | panel.params[3];
+            }
+            break;
+        case MIPI_DCS_SET_SCROLL_AREA:
+            if (6 == panel.count) {
+                const uint16_t tfa = (panel.params[0] << 8) | panel.params[1];
+                const uint16_t vsa = (panel.params[2] << 8) | panel.params[3];
+                const uint16_t bfa = (panel.params[4] << 8) | panel.params[5];
+
+                /* Areas must cover the memory exactly, others are ignored. */
+                if (tfa + vsa + bfa == GRAM_HEIGHT) {
+                    panel.tfa = tfa;
+                    panel.vsa = vsa;
+                } else {
+                    stats.invalid++;
+                }
+            }
+            break;
+        case MIPI_DCS_SET_SCROLL_START:
+            if (2 == panel.count) {
+                panel.vsp = (panel.params[0] << 8) | panel.params[1];
+            }
+            break;
+        case MIPI_DCS_WRITE_MEMORY_START:
+        case MIPI_DCS_WRITE_MEMORY_CONTINUE:
+            pixel_data(byte);
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+panel_read(uint8_t *data, size_t length)
+{
+    memset(data, 0, length);
+
+    switch (panel.command) {
+        case MIPI_DCS_GET_ADDRESS_MODE:
+            data[length - 1] = panel.address_mode;
+            break;
+        case MIPI_DCS_GET_PIXEL_FORMAT:
+            data[length - 1] = panel.pixel_format;
+            break;
+        case MIPI_DCS_GET_POWER_MODE:
+            /* Booster, sleep out and display on bits are always set. */
+            data[length - 1] = 0x94 | (panel.idle << 6) | (panel.partial << 5) | (!panel.partial << 3);
+            break;
+        case MIPI_DCS_GET_SCANLINE:
+            if (length >= 2) {
+                data[length - 2] = panel.scanline >> 8;
+                data[length - 1] = panel.scanline & 0xff;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+execute(spi_device_handle_t handle, spi_transaction_t *transaction)
+{
+    const uint8_t *tx;
+    uint8_t *rx;
+    size_t length = transaction->length / 8;
+    size_t rxlength = transaction->rxlength / 8;
+
+    if (handle->config.pre_cb) {
+        handle->config.pre_cb(transaction);
+    }
+
+    pthread_mutex_lock(&lock);
+
+    if (transaction->flags & SPI_TRANS_USE_TXDATA) {
+        tx = transaction->tx_data;
+    } else {
+        tx = transaction->tx_buffer;
+        if (length && !esp_ptr_dma_capable(tx)) {
+            stats.external++;
+        }
+    }
+    if (transaction->flags & SPI_TRANS_USE_RXDATA) {
+        rx = transaction->rx_data;
+    } else {
+        rx = transaction->rx_buffer;
+    }
+
+    if (handle->config.address_bits) {
+        /* QSPI, command is in the address phase. Continue keeps position. */
+        const uint8_t command = (transaction->addr >> 8) & 0xff;
+        const bool color = MIPI_DCS_WRITE_MEMORY_START == command || MIPI_DCS_WRITE_MEMORY_CONTINUE == command;
+
+        /* Pixel data goes on four lines, everything else on one. */
+        if (color != (QSPI_OPCODE_WRITE_COLOR == transaction->cmd) ||
+            color != !!(transaction->flags & SPI_TRANS_MODE_QIO)) {
+            stats.invalid++;
+        }
+        panel_command(command);
+        for (size_t i = 0; i < length; i++) {
+            panel_data(tx[i]);
+        }
+        stats.commands++;
+    } else if (gpio_get_level(CONFIG_MIPI_DISPLAY_PIN_DC)) {
+        for (size_t i = 0; i < length; i++) {
+            panel_data(tx[i]);
+        }
+    } else {
+        for (size_t i = 0; i < length; i++) {
+            panel_command(tx[i]);
+        }
+        stats.commands += length;
+    }
+
+    if (rx && rxlength) {
+        panel_read(rx, rxlength);
+    }
+
+    /* Command and address phases are always on one line. */
+    const size_t header = (handle->config.command_bits + handle->config.address_bits) / 8;
+    const uint8_t lines = (transaction->flags & SPI_TRANS_MODE_QIO) ? 4 : 1;
+
+    stats.transactions++;
+    stats.bytes += header + length;
+    stats.wire_ns += (uint64_t) (header * lines + length + rxlength) * 8 * 1000000000ULL / lines / handle->config.clock_speed_hz;
+    stats.wire_ns += overhead_ns;
+
+    pthread_mutex_unlock(&lock);
+
+    if (handle->config.post_cb) {
+        handle->config.post_cb(transaction);
+    }
+}
+
+esp_err_t
+spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *config, int dma_chan)
+{
+    return ESP_OK;
+}
+
+esp_err_t
+spi_bus_free(spi_host_device_t host)
+{
+    return ESP_OK;
+}
+
+esp_err_t
+spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config, spi_device_handle_t *handle)
+{
+    spi_device_handle_t device = calloc(1, sizeof(struct spi_device_t));
+
+    device->config = *config;
+    device->results = calloc(config->queue_size, sizeof(spi_transaction_t *));
+    *handle = device;
+
+    return ESP_OK;
+}
+
+esp_err_t
+spi_bus_remove_device(spi_device_handle_t handle)
+{
+    free(handle->results);
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t
+spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *transaction, TickType_t ticks)
+{
+    /* Real driver would lose the result, make it loud instead. */
+    if (handle->count == (size_t) handle->config.queue_size) {
+        fprintf(stderr, "virtual_panel: queue overflow, results were not collected\n");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    execute(handle, transaction);
+
+    handle->results[(handle->head + handle->count) % handle->config.queue_size] = transaction;
+    handle->count++;
+
+    return ESP_OK;
+}
+
+esp_err_t
+spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **transaction, TickType_t ticks)
+{
+    if (0 == handle->count) {
+        /* Nothing in flight, real driver would block forever. */
+        if (portMAX_DELAY == ticks) {
+            fprintf(stderr, "virtual_panel: waiting for a result which never comes\n");
+            abort();
+        }
+        return ESP_ERR_TIMEOUT;
+    }
+
+    *transaction = handle->results[handle->head];
+    handle->head = (handle->head + 1) % handle->config.queue_size;
+    handle->count--;
+
+    return ESP_OK;
+}
+
+esp_err_t
+spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *transaction)
+{
+    execute(handle, transaction);
+    return ESP_OK;
+}
+
+esp_err_t
+spi_device_polling_start(spi_device_handle_t handle, spi_transaction_t *transaction, TickType_t ticks)
+{
+    execute(handle, transaction);
+    return ESP_OK;
+}
+
+esp_err_t
+spi_device_polling_end(spi_device_handle_t handle, TickType_t ticks)
+{
+    return ESP_OK;
+}
+
+esp_err_t
+spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *transaction)
+{
+    execute(handle, transaction);
+    return ESP_OK;
+}
+
+esp_err_t
+spi_device_acquire_bus(spi_device_handle_t device, TickType_t wait)
+{
+    return ESP_OK;
+}
+
+void
+spi_device_release_bus(spi_device_handle_t dev)
+{
+}
+
+/*
+ * One WR strobe writes the command, each parameter and each bus width
+ * of pixel data. Swapping of 16 bit pixels cancels out, panel gets the
+ * bytes in memory order.
+ */
+static void
+i80_execute(esp_lcd_panel_io_handle_t io, int command, const uint8_t *data, size_t length, size_t width)
+{
+    pthread_mutex_lock(&lock);
+
+    if (command >= 0) {
+        panel_command(command);
+        stats.commands++;
+    }
+    for (size_t i = 0; i < length; i++) {
+        panel_data(data[i]);
+    }
+    if (length && !esp_ptr_dma_capable(data)) {
+        stats.external++;
+    }
+
+    const size_t strobes = (command >= 0) + (length + width - 1) / width;
+
+    stats.transactions++;
+    stats.bytes += (command >= 0) + length;
+    stats.wire_ns += (uint64_t) strobes * 1000000000ULL / io->config.pclk_hz;
+    stats.wire_ns += overhead_ns;
+
+    pthread_mutex_unlock(&lock);
+}
+
+esp_err_t
+esp_lcd_new_i80_bus(const esp_lcd_i80_bus_config_t *config, esp_lcd_i80_bus_handle_t *bus)
+{
+    *bus = calloc(1, sizeof(struct esp_lcd_i80_bus_t));
+    (*bus)->config = *config;
+    return ESP_OK;
+}
+
+esp_err_t
+esp_lcd_del_i80_bus(esp_lcd_i80_bus_handle_t bus)
+{
+    free(bus);
+    return ESP_OK;
+}
+
+esp_err_t
+esp_lcd_new_panel_io_i80(esp_lcd_i80_bus_handle_t bus, const esp_lcd_panel_io_i80_config_t *config, esp_lcd_panel_io_handle_t *io)
+{
+    *io = calloc(1, sizeof(struct esp_lcd_panel_io_t));
+    (*io)->bus = bus;
+    (*io)->config = *config;
+    return ESP_OK;
+}
+
+esp_err_t
+esp_lcd_panel_io_del(esp_lcd_panel_io_handle_t io)
+{
+    free(io);
+    return ESP_OK;
+}
+
+esp_err_t
+esp_lcd_panel_io_tx_param(esp_lcd_panel_io_handle_t io, int command, const void *param, size_t size)
+{
+    i80_execute(io, command, param, size, 1);
+    return ESP_OK;
+}
+
+esp_err_t
+esp_lcd_panel_io_tx_color(esp_lcd_panel_io_handle_t io, int command, const void *color, size_t size)
+{
+    /* Real driver allocates DMA descriptors for this much only. */
+    if (size > io->bus->config.max_transfer_bytes) {
+        fprintf(stderr, "virtual_panel: color transfer of %zu bytes is too large\n", size);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i80_execute(io, command, color, size, io->bus->config.bus_width / 8);
+
+    if (io->config.on_color_trans_done) {
+        esp_lcd_panel_io_event_data_t event = {0};
+        io->config.on_color_trans_done(io, &event, io->config.user_ctx);
+    }
+    return ESP_OK;
+}
+
+void
+virtual_panel_get_stats(virtual_panel_stats_t *out)
+{
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
+
+void
+virtual_panel_reset_stats(void)
+{
+    pthread_mutex_lock(&lock);
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&lock);
+}
+
+void
+virtual_panel_set_transaction_overhead(uint32_t ns)
+{
+    overhead_ns = ns;
+}
+
+uint8_t
+virtual_panel_get_address_mode(void)
+{
+    return panel.address_mode;
+}
+
+uint8_t
+virtual_panel_get_pixel_format(void)
+{
+    return panel.pixel_format;
+}
+
+bool
+virtual_panel_get_tear_on(void)
+{
+    return panel.tear_on;
+}
+
+uint16_t
+virtual_panel_get_tear_scanline(void)
+{
+    return panel.tear_scanline;
+}
+
+void
+virtual_panel_set_scanline(uint16_t scanline)
+{
+    pthread_mutex_lock(&lock);
+    panel.scanline = scanline;
+    pthread_mutex_unlock(&lock);
+}
+
+bool
+virtual_panel_te_pulse(void)
+{
+    /* Panel sends the pulse when scan reaches the tear scanline. */
+    virtual_panel_set_scanline(panel.tear_scanline);
+
+    if (!panel.tear_on) {
+        return false;
+    }
+
+#if CONFIG_MIPI_DISPLAY_PIN_TE >= 0
+    gpio_host_set_input(CONFIG_MIPI_DISPLAY_PIN_TE, 1);
+    gpio_host_set_input(CONFIG_MIPI_DISPLAY_PIN_TE, 0);
+#endif /* CONFIG_MIPI_DISPLAY_PIN_TE >= 0 */
+    return true;
+}
+
+void
+virtual_panel_get_window(uint16_t *xs, uint16_t *ys, uint16_t *xe, uint16_t *ye)
+{
+    *xs = panel.xs;
+    *ys = panel.ys;
+    *xe = panel.xe;
+    *ye = panel.ye;
+}
+
+uint16_t
+virtual_panel_get_scroll_start(void)
+{
+    return panel.vsp;
+}
+
+void
+virtual_panel_get_scroll_area(uint16_t *tfa, uint16_t *vsa)
+{
+    *tfa = panel.tfa;
+    *vsa = panel.vsa;
+}
+
+uint32_t
+virtual_panel_get_pixel(uint16_t x0, uint16_t y0)
+{
+    uint16_t x = x0 + CONFIG_MIPI_DISPLAY_OFFSET_X;
+    uint16_t y = y0 + CONFIG_MIPI_DISPLAY_OFFSET_Y;
+
+    if (x >= GRAM_WIDTH || y >= GRAM_HEIGHT) {
+        return 0;
+    }
+
+    /* Rows outside the partial area are black. */
+    if (panel.partial && (y < panel.sr || y > panel.er)) {
+        return 0;
+    }
+
+    /* Scrolling area shows memory starting from the scroll start line. */
+    if (y >= panel.tfa && y < panel.tfa + panel.vsa) {
+        y = panel.tfa + (y - panel.tfa + panel.vsp - panel.tfa) % panel.vsa;
+    }
+    return panel.gram[y * GRAM_WIDTH + x];
+}
+
+int
+virtual_panel_dump_ppm(const char *filename)
+{
+    FILE *file = fopen(filename, "wb");
+
+    if (NULL == file) {
+        return -1;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", CONFIG_MIPI_DISPLAY_WIDTH, CONFIG_MIPI_DISPLAY_HEIGHT);
+    for (uint16_t y = 0; y < CONFIG_MIPI_DISPLAY_HEIGHT; y++) {
+        for (uint16_t x = 0; x < CONFIG_MIPI_DISPLAY_WIDTH; x++) {
+            uint32_t color = virtual_panel_get_pixel(x, y);
+            fputc((color >> 16) & 0xff, file);
+            fputc((color >> 8) & 0xff, file);
+            fputc(color & 0xff, file);
+        }
+    }
+
+    return fclose(file);
+}
@@ -0,0 +1,789 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Checks the traffic sent to the virtual panel. Only the checks for the
+features enabled in the build are run.
+
+$ cmake -S host -B build -DHAGL_DIR=/path/to/hagl -DHAGL_HAL_BUFFERING=double \
+    -DHAGL_HAL_DEFINITIONS=CONFIG_HAGL_HAL_DIRTY_RECTANGLES=1
+$ cmake --build build
+$ ctest --test-dir build
+
+Tearing effect wait is checked with CONFIG_MIPI_DISPLAY_TE_SYNC=1 and
+CONFIG_MIPI_DISPLAY_PIN_TE set.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <mipi_display.h>
+#include <hagl_hal.h>
+#include <hagl.h>
+#include <hagl/bitmap.h>
+#include <virtual_panel.h>
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static int failures = 0;
+static int checks = 0;
+
+static inline void
+check(bool passed, const char *condition, int line)
+{
+    checks++;
+    if (!passed) {
+        printf("FAIL line %d: %s\n", line, condition);
+        failures++;
+    }
+}
+
+/* Flushes and returns the traffic it caused, also from a flush task. */
+static inline void
+flush_stats(hagl_backend_t *backend, virtual_panel_stats_t *stats)
+{
+    virtual_panel_reset_stats();
+    hagl_flush(backend);
+#ifdef CONFIG_HAGL_HAL_USE_TRIPLE_BUFFERING
+    vTaskDelay(pdMS_TO_TICKS(50));
+#endif /* CONFIG_HAGL_HAL_USE_TRIPLE_BUFFERING */
+    virtual_panel_get_stats(stats);
+}
+
+static void
+test_clip_rect(void)
+{
+    const hagl_window_t clip = {.x0 = 0, .y0 = 0, .x1 = 99, .y1 = 49};
+    int16_t x0 = 10;
+    int16_t y0 = 5;
+    uint16_t w = 65535;
+    uint16_t h = 40000;
+
+    /* Right and bottom edges would not fit in int16_t. */
+    CHECK(hagl_hal_clip_rect(&clip, &x0, &y0, &w, &h));
+    CHECK(10 == x0 && 5 == y0 && 90 == w && 45 == h);
+
+    x0 = -20000;
+    y0 = -20000;
+    w = 65535;
+    h = 65535;
+    CHECK(hagl_hal_clip_rect(&clip, &x0, &y0, &w, &h));
+    CHECK(0 == x0 && 0 == y0 && 100 == w && 50 == h);
+
+    x0 = 100;
+    y0 = 0;
+    w = 10;
+    h = 10;
+    CHECK(!hagl_hal_clip_rect(&clip, &x0, &y0, &w, &h));
+}
+
+#ifdef CONFIG_HAGL_HAL_NO_BUFFERING
+/* Panel expects RGB565 big endian. */
+static hagl_color_t
+rgb565(uint8_t r, uint8_t g, uint8_t b)
+{
+    const uint16_t color = ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);
+    return (color >> 8) | (color << 8);
+}
+
+static void
+test_transport(hagl_backend_t *backend)
+{
+    virtual_panel_stats_t stats;
+
+    /* Commands, parameters and pixels arrive in the right order. */
+    virtual_panel_reset_stats();
+    hagl_put_pixel(backend, 1, 1, rgb565(255, 0, 0));
+    hagl_put_pixel(backend, 2, 1, rgb565(0, 255, 0));
+    hagl_put_pixel(backend, 3, 1, rgb565(0, 0, 255));
+    hagl_flush(backend);
+    CHECK(0xf80000 == virtual_panel_get_pixel(1, 1));
+    CHECK(0x00fc00 == virtual_panel_get_pixel(2, 1));
+    CHECK(0x0000f8 == virtual_panel_get_pixel(3, 1));
+
+    /* Large writes are split to what the bus can send at once. */
+    virtual_panel_reset_stats();
+    hagl_hal_fill_rect(backend, 0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT, rgb565(255, 255, 255));
+    virtual_panel_get_stats(&stats);
+    CHECK(DISPLAY_WIDTH * DISPLAY_HEIGHT == stats.pixels);
+    CHECK(0xf8fcf8 == virtual_panel_get_pixel(DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1));
+    CHECK(0 == stats.invalid);
+
+#ifdef CONFIG_MIPI_DISPLAY_QSPI
+    /* Pixels are sent on four lines. */
+    CHECK(stats.wire_ns < stats.bytes * 8 * 1000000000ULL / CONFIG_MIPI_DISPLAY_SPI_CLOCK_SPEED_HZ / 2);
+#endif /* CONFIG_MIPI_DISPLAY_QSPI */
+
+#ifdef CONFIG_MIPI_DISPLAY_TRANSPORT_I80
+    /* Each WR strobe sends the whole bus width. */
+    const uint64_t strobes = stats.bytes / (CONFIG_MIPI_DISPLAY_I80_BUS_WIDTH / 8) + stats.transactions;
+    CHECK(stats.wire_ns <= strobes * 1000000000ULL / CONFIG_MIPI_DISPLAY_I80_CLOCK_SPEED_HZ);
+#endif /* CONFIG_MIPI_DISPLAY_TRANSPORT_I80 */
+
+    hagl_hal_fill_rect(backend, 0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT, 0x0000);
+}
+
+static void
+test_fences(hagl_backend_t *backend)
+{
+    mipi_display_t *display = hagl_hal_get_display(backend);
+    static uint16_t pixels[32 * 8];
+    uint32_t first, second;
+
+    for (uint16_t i = 0; i < 32 * 8; i++) {
+        pixels[i] = 0xffff;
+    }
+
+    /* Each write gets a new fence which is done once sent. */
+    first = mipi_display_write_async(display, 0, 0, 32, 8, (uint8_t *) pixels);
+    second = mipi_display_write_async(display, 0, 8, 32, 8, (uint8_t *) pixels);
+    CHECK(0 != first);
+    CHECK(first + 1 == second);
+
+    mipi_display_fence_wait(display, second);
+    CHECK(mipi_display_fence_done(display, first));
+    CHECK(mipi_display_fence_done(display, second));
+    CHECK(!mipi_display_fence_done(display, second + 1));
+    CHECK(0 != virtual_panel_get_pixel(31, 15));
+
+    /* Nothing to send returns a fence which is already done. */
+    CHECK(second == mipi_display_write_async(display, 0, 0, 0, 8, (uint8_t *) pixels));
+}
+#endif /* CONFIG_HAGL_HAL_NO_BUFFERING */
+
+#if defined(CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING) && defined(CONFIG_HAGL_HAL_DIRTY_RECTANGLES)
+static void
+test_dirty_rectangles(hagl_backend_t *backend)
+{
+    virtual_panel_stats_t stats;
+    uint16_t xs, ys, xe, ye;
+    size_t size;
+
+    /* First flush sends the whole back buffer. */
+    size = hagl_flush(backend);
+    CHECK(BITMAP_SIZE(DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_DEPTH) == size);
+
+    /* Only the changed area is sent, in one window. */
+    hagl_hal_fill_rect(backend, 13, 17, 101, 33, 0x1234);
+    virtual_panel_reset_stats();
+    size = hagl_flush(backend);
+    virtual_panel_get_stats(&stats);
+    virtual_panel_get_window(&xs, &ys, &xe, &ye);
+
+    CHECK(BITMAP_SIZE(101, 33, DISPLAY_DEPTH) == size);
+    CHECK(101 * 33 == stats.pixels);
+    CHECK(1 == stats.memory_writes);
+    CHECK(13 + CONFIG_MIPI_DISPLAY_OFFSET_X == xs && 113 + CONFIG_MIPI_DISPLAY_OFFSET_X == xe);
+    CHECK(17 + CONFIG_MIPI_DISPLAY_OFFSET_Y == ys && 49 + CONFIG_MIPI_DISPLAY_OFFSET_Y == ye);
+
+    /* Separate areas are sent in separate windows. */
+    hagl_hal_fill_rect(backend, 0, 0, 10, 10, 0x5678);
+    hagl_hal_fill_rect(backend, 200, 200, 20, 5, 0x9abc);
+    virtual_panel_reset_stats();
+    size = hagl_flush(backend);
+    virtual_panel_get_stats(&stats);
+
+    CHECK(BITMAP_SIZE(10, 10, DISPLAY_DEPTH) + BITMAP_SIZE(20, 5, DISPLAY_DEPTH) == size);
+    CHECK(10 * 10 + 20 * 5 == stats.pixels);
+    CHECK(2 == stats.memory_writes);
+
+    /* Touching areas are merged into one window. */
+    hagl_hal_fill_rect(backend, 50, 100, 10, 10, 0x1111);
+    hagl_hal_fill_rect(backend, 60, 100, 10, 10, 0x2222);
+    virtual_panel_reset_stats();
+    size = hagl_flush(backend);
+    virtual_panel_get_stats(&stats);
+    virtual_panel_get_window(&xs, &ys, &xe, &ye);
+
+    CHECK(BITMAP_SIZE(20, 10, DISPLAY_DEPTH) == size);
+    CHECK(1 == stats.memory_writes);
+    CHECK(50 + CONFIG_MIPI_DISPLAY_OFFSET_X == xs && 69 + CONFIG_MIPI_DISPLAY_OFFSET_X == xe);
+
+    /* Unclipped scaled blit is clamped to the back buffer. */
+    static hagl_color_t pixels[4 * 4];
+    hagl_bitmap_t src;
+    hagl_bitmap_init(&src, 4, 4, DISPLAY_DEPTH, pixels);
+    backend->scale_blit(backend, DISPLAY_WIDTH - 8, DISPLAY_HEIGHT - 8, 16, 16, &src);
+    virtual_panel_reset_stats();
+    size = hagl_flush(backend);
+    virtual_panel_get_stats(&stats);
+
+    CHECK(BITMAP_SIZE(8, 8, DISPLAY_DEPTH) == size);
+    CHECK(8 * 8 == stats.pixels);
+
+    /* Nothing drawn, nothing sent. */
+    virtual_panel_reset_stats();
+    size = hagl_flush(backend);
+    virtual_panel_get_stats(&stats);
+
+    CHECK(0 == size);
+    CHECK(0 == stats.pixels);
+
+    /* Areas outside of the partial area are sent after waking up. */
+    hagl_put_pixel(backend, 5, 10, 0xffff);
+    hagl_hal_standby(backend, 0, 100, DISPLAY_WIDTH, 20, false);
+    hagl_flush(backend);
+    hagl_hal_wake(backend);
+    hagl_flush(backend);
+    CHECK(0 != virtual_panel_get_pixel(5, 10));
+}
+#endif /* CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING && CONFIG_HAGL_HAL_DIRTY_RECTANGLES */
+
+#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
+static atomic_bool stopped;
+static atomic_uint frames;
+
+static void *
+draw_frames(void *arg)
+{
+    hagl_backend_t *backend = arg;
+
+    /* Every frame covers the whole screen with one color. */
+    while (!atomic_load(&stopped)) {
+        const hagl_color_t color = (atomic_load(&frames) & 1) ? 0xf800 : 0x001f;
+        hagl_hal_fill_rect(backend, 0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT, color);
+        atomic_fetch_add(&frames, 1);
+    }
+    return NULL;
+}
+
+static void
+test_snapshot(hagl_backend_t *backend)
+{
+    pthread_t thread;
+    int torn = 0;
+
+    atomic_store(&stopped, false);
+    atomic_store(&frames, 0);
+    pthread_create(&thread, NULL, draw_frames, backend);
+    while (atomic_load(&frames) < 2) {
+        usleep(100);
+    }
+
+    /* Flush keeps up with drawing and never sends a band with two frames. */
+    for (uint8_t i = 0; i < 10; i++) {
+        const unsigned int before = atomic_load(&frames);
+
+        hagl_flush(backend);
+        for (uint16_t y = 0; y < DISPLAY_HEIGHT; y++) {
+            const uint16_t band = y - y % CONFIG_HAGL_HAL_SNAPSHOT_LINES;
+            torn += virtual_panel_get_pixel(0, y) != virtual_panel_get_pixel(0, band);
+            torn += virtual_panel_get_pixel(DISPLAY_WIDTH - 1, y) != virtual_panel_get_pixel(0, band);
+        }
+        while (atomic_load(&frames) == before) {
+            usleep(100);
+        }
+    }
+    CHECK(0 == torn);
+
+    atomic_store(&stopped, true);
+    pthread_join(thread, NULL);
+
+    /* Without drawing the whole frame is sent as is. */
+    hagl_flush(backend);
+    CHECK(0 != virtual_panel_get_pixel(0, 0));
+    CHECK(virtual_panel_get_pixel(0, 0) == virtual_panel_get_pixel(DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1));
+}
+#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
+
+#if defined(CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING) && defined(CONFIG_HAGL_HAL_ROW_HASH)
+static void
+test_row_hash(hagl_backend_t *backend)
+{
+    virtual_panel_stats_t stats;
+
+    /* First flush sends everything, then nothing until something changes. */
+    flush_stats(backend, &stats);
+    CHECK(DISPLAY_WIDTH * DISPLAY_HEIGHT == stats.pixels);
+    flush_stats(backend, &stats);
+    CHECK(0 == stats.pixels);
+
+    /* Adjacent changed rows are sent in one window, others separately. */
+    hagl_hal_fill_rect(backend, 10, 20, 5, 3, 0x1234);
+    hagl_put_pixel(backend, 300, 200, 0x5678);
+    flush_stats(backend, &stats);
+    CHECK(4 * DISPLAY_WIDTH == stats.pixels);
+    CHECK(2 == stats.memory_writes);
+
+    /* Same content drawn again is not sent. */
+    hagl_hal_fill_rect(backend, 10, 20, 5, 3, 0x1234);
+    flush_stats(backend, &stats);
+    CHECK(0 == stats.pixels);
+
+    /* Rows outside of the partial area are sent after waking up. */
+    hagl_put_pixel(backend, 5, 10, 0x1111);
+    hagl_put_pixel(backend, 5, 105, 0x2222);
+    hagl_hal_standby(backend, 0, 100, DISPLAY_WIDTH, 20, false);
+    flush_stats(backend, &stats);
+    CHECK(DISPLAY_WIDTH == stats.pixels);
+    hagl_hal_wake(backend);
+    flush_stats(backend, &stats);
+    CHECK(DISPLAY_WIDTH == stats.pixels);
+    CHECK(0 != virtual_panel_get_pixel(5, 10));
+}
+#endif /* CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING && CONFIG_HAGL_HAL_ROW_HASH */
+
+#ifdef CONFIG_HAGL_HAL_COALESCE_PIXELS
+static void
+test_coalesce_pixels(hagl_backend_t *backend)
+{
+    virtual_panel_stats_t stats;
+
+    /* Adjacent pixels are sent as one span when flushing. */
+    virtual_panel_reset_stats();
+    for (int16_t x = 20; x < 60; x++) {
+        hagl_put_pixel(backend, x, 5, 0xffff);
+    }
+    virtual_panel_get_stats(&stats);
+    CHECK(0 == stats.pixels);
+
+    hagl_flush(backend);
+    virtual_panel_get_stats(&stats);
+    CHECK(40 == stats.pixels);
+    CHECK(1 == stats.memory_writes);
+    CHECK(0 != virtual_panel_get_pixel(20, 5));
+    CHECK(0 != virtual_panel_get_pixel(59, 5));
+
+    /* New row or a gap starts a new span. */
+    virtual_panel_reset_stats();
+    hagl_put_pixel(backend, 20, 6, 0xffff);
+    hagl_put_pixel(backend, 21, 6, 0xffff);
+    hagl_put_pixel(backend, 20, 7, 0xffff);
+    hagl_put_pixel(backend, 22, 7, 0xffff);
+    hagl_flush(backend);
+    virtual_panel_get_stats(&stats);
+    CHECK(4 == stats.pixels);
+    CHECK(3 == stats.memory_writes);
+
+    /* Other drawing operations send the pending span first. */
+    virtual_panel_reset_stats();
+    hagl_put_pixel(backend, 30, 8, 0x0000);
+    hagl_draw_hline_xyw(backend, 30, 8, 10, 0xffff);
+    virtual_panel_get_stats(&stats);
+    CHECK(2 == stats.memory_writes);
+    CHECK(0 != virtual_panel_get_pixel(30, 8));
+}
+#endif /* CONFIG_HAGL_HAL_COALESCE_PIXELS */
+
+#ifdef CONFIG_HAGL_HAL_USE_STRIP_BUFFERING
+typedef struct {
+    uint16_t calls;
+    uint16_t rows;
+} strips_t;
+
+static void
+draw_scene(hagl_backend_t *backend, void *user)
+{
+    strips_t *strips = user;
+
+    strips->calls++;
+    strips->rows += backend->clip.y1 - backend->clip.y0 + 1;
+
+    /* Crosses the border of the first two strips. */
+    hagl_hal_fill_rect(backend, 10, 10, 50, CONFIG_HAGL_HAL_STRIP_HEIGHT, 0xffff);
+}
+
+static void
+test_strip_render(hagl_backend_t *backend)
+{
+    const uint16_t count = (DISPLAY_HEIGHT + CONFIG_HAGL_HAL_STRIP_HEIGHT - 1) / CONFIG_HAGL_HAL_STRIP_HEIGHT;
+    virtual_panel_stats_t stats;
+    strips_t strips = {0};
+    size_t size;
+
+    /* Scene is drawn once per strip, each strip is sent once. */
+    virtual_panel_reset_stats();
+    size = hagl_hal_render(backend, draw_scene, &strips);
+    virtual_panel_get_stats(&stats);
+
+    CHECK(count == strips.calls);
+    CHECK(DISPLAY_HEIGHT == strips.rows);
+    CHECK(BITMAP_SIZE(DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_DEPTH) == size);
+    CHECK(DISPLAY_WIDTH * DISPLAY_HEIGHT == stats.pixels);
+    CHECK(count == stats.memory_writes);
+
+    CHECK(0 != virtual_panel_get_pixel(10, 10));
+    CHECK(0 != virtual_panel_get_pixel(59, 9 + CONFIG_HAGL_HAL_STRIP_HEIGHT));
+    CHECK(0 == virtual_panel_get_pixel(60, 10));
+    CHECK(0 == virtual_panel_get_pixel(10, 10 + CONFIG_HAGL_HAL_STRIP_HEIGHT));
+
+    /* Only strips inside the clip window are drawn. */
+    strips.calls = 0;
+    strips.rows = 0;
+    hagl_set_clip(backend, 0, CONFIG_HAGL_HAL_STRIP_HEIGHT, DISPLAY_WIDTH - 1, 2 * CONFIG_HAGL_HAL_STRIP_HEIGHT - 1);
+    size = hagl_hal_render(backend, draw_scene, &strips);
+
+    CHECK(1 == strips.calls);
+    CHECK(CONFIG_HAGL_HAL_STRIP_HEIGHT == strips.rows);
+    CHECK(BITMAP_SIZE(DISPLAY_WIDTH, CONFIG_HAGL_HAL_STRIP_HEIGHT, DISPLAY_DEPTH) == size);
+
+    /* Clip window of the caller is restored. */
+    CHECK(CONFIG_HAGL_HAL_STRIP_HEIGHT == backend->clip.y0);
+    hagl_set_clip(backend, 0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1);
+}
+#endif /* CONFIG_HAGL_HAL_USE_STRIP_BUFFERING */
+
+#ifdef CONFIG_HAGL_HAL_USE_TILED_BUFFERING
+#define TILE_WIDTH  (CONFIG_HAGL_HAL_TILE_WIDTH)
+#define TILE_HEIGHT (CONFIG_HAGL_HAL_TILE_HEIGHT)
+
+static void
+test_tiles(hagl_backend_t *backend)
+{
+    const uint16_t tiles = ((DISPLAY_WIDTH + TILE_WIDTH - 1) / TILE_WIDTH) * ((DISPLAY_HEIGHT + TILE_HEIGHT - 1) / TILE_HEIGHT);
+    static hagl_color_t pixels[4 * 4];
+    virtual_panel_stats_t stats;
+    hagl_bitmap_t src;
+
+    /* First flush clears the whole display, then empty tiles are skipped. */
+    flush_stats(backend, &stats);
+    CHECK(tiles == stats.memory_writes);
+    CHECK(DISPLAY_WIDTH * DISPLAY_HEIGHT == stats.pixels);
+    flush_stats(backend, &stats);
+    CHECK(0 == stats.memory_writes);
+
+    /* Only the touched tile is sent, operations are rasterized in order. */
+    hagl_hal_fill_rect(backend, 1, 1, 4, 4, 0xffff);
+    hagl_hal_fill_rect(backend, 2, 2, 2, 2, 0x1234);
+    flush_stats(backend, &stats);
+    CHECK(1 == stats.memory_writes);
+    CHECK(TILE_WIDTH * TILE_HEIGHT == stats.pixels);
+    CHECK(0 != virtual_panel_get_pixel(1, 1));
+    CHECK(0 != virtual_panel_get_pixel(2, 2));
+    CHECK(virtual_panel_get_pixel(1, 1) != virtual_panel_get_pixel(2, 2));
+    CHECK(0 == virtual_panel_get_pixel(5, 1));
+
+    /* Drawing crossing a tile border sends both tiles. Tile drawn on the
+       previous frame but not on this one is cleared. */
+    hagl_hal_fill_rect(backend, 2 * TILE_WIDTH - 2, 0, 4, 4, 0xffff);
+    flush_stats(backend, &stats);
+    CHECK(3 == stats.memory_writes);
+    CHECK(0 == virtual_panel_get_pixel(1, 1));
+    CHECK(0 != virtual_panel_get_pixel(2 * TILE_WIDTH - 2, 0));
+    CHECK(0 != virtual_panel_get_pixel(2 * TILE_WIDTH + 1, 3));
+
+    flush_stats(backend, &stats);
+    CHECK(2 == stats.memory_writes);
+    flush_stats(backend, &stats);
+    CHECK(0 == stats.memory_writes);
+
+    /* Bitmaps are copied to the display list when drawn. */
+    memset(pixels, 0xff, sizeof(pixels));
+    hagl_bitmap_init(&src, 4, 4, DISPLAY_DEPTH, pixels);
+    hagl_blit(backend, 20, 20, &src);
+    memset(pixels, 0x00, sizeof(pixels));
+    flush_stats(backend, &stats);
+    CHECK(0 != virtual_panel_get_pixel(20, 20));
+    CHECK(0 != virtual_panel_get_pixel(23, 23));
+}
+#endif /* CONFIG_HAGL_HAL_USE_TILED_BUFFERING */
+
+#ifdef CONFIG_HAGL_HAL_BUFFER_AGE
+static void
+test_buffer_age(hagl_backend_t *backend)
+{
+    hagl_window_t areas[CONFIG_HAGL_HAL_DAMAGE_RECTANGLES_MAX];
+    virtual_panel_stats_t stats;
+
+    /* Nothing is known about the buffers until both have been sent. */
+    CHECK(0 == hagl_hal_buffer_age(backend));
+    CHECK(1 == hagl_hal_get_damage(backend, areas));
+    CHECK(0 == areas[0].x0 && DISPLAY_WIDTH - 1 == areas[0].x1);
+
+    hagl_hal_fill_rect(backend, 10, 10, 20, 20, 0xf800);
+    flush_stats(backend, &stats);
+    CHECK(0 == hagl_hal_buffer_age(backend));
+
+    /* Back buffer is two frames old and lacks what was drawn since. */
+    hagl_hal_fill_rect(backend, 100, 100, 10, 10, 0x07e0);
+    flush_stats(backend, &stats);
+    CHECK(2 == hagl_hal_buffer_age(backend));
+    CHECK(1 == hagl_hal_get_damage(backend, areas));
+    CHECK(100 == areas[0].x0 && 100 == areas[0].y0 && 109 == areas[0].x1 && 109 == areas[0].y1);
+    CHECK(0xf800 == backend->get_pixel(backend, 10, 10));
+    CHECK(0x0000 == backend->get_pixel(backend, 100, 100));
+
+    /* Copying the damage makes it hold the previous frame. */
+    hagl_hal_copy_damage(backend);
+    CHECK(1 == hagl_hal_buffer_age(backend));
+    CHECK(0 == hagl_hal_get_damage(backend, areas));
+    CHECK(0x07e0 == backend->get_pixel(backend, 100, 100));
+
+    /* Only the changes of the next frame are drawn. */
+    hagl_hal_fill_rect(backend, 200, 50, 5, 5, 0x001f);
+    flush_stats(backend, &stats);
+    CHECK(2 == hagl_hal_buffer_age(backend));
+    CHECK(1 == hagl_hal_get_damage(backend, areas));
+    CHECK(200 == areas[0].x0 && 50 == areas[0].y0 && 204 == areas[0].x1 && 54 == areas[0].y1);
+    CHECK(0 != virtual_panel_get_pixel(10, 10));
+    CHECK(0 != virtual_panel_get_pixel(100, 100));
+    CHECK(0 != virtual_panel_get_pixel(200, 50));
+}
+#endif /* CONFIG_HAGL_HAL_BUFFER_AGE */
+
+#ifdef CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING
+static void
+test_default_palette(hagl_backend_t *backend)
+{
+    /* Indices are RGB332 until the palette is changed. */
+    hagl_hal_fill_rect(backend, 0, 0, 10, 10, 0xe0);
+    hagl_hal_fill_rect(backend, 10, 0, 10, 10, 0x1c);
+    hagl_hal_fill_rect(backend, 20, 0, 10, 10, 0x03);
+    hagl_hal_fill_rect(backend, 30, 0, 10, 10, 0xff);
+    hagl_flush(backend);
+    vTaskDelay(pdMS_TO_TICKS(50));
+
+    /* Only the top bits of each channel are compared. */
+    CHECK(0xe00000 == (virtual_panel_get_pixel(5, 5) & 0xe0e0c0));
+    CHECK(0x00e000 == (virtual_panel_get_pixel(15, 5) & 0xe0e0c0));
+    CHECK(0x0000c0 == (virtual_panel_get_pixel(25, 5) & 0xe0e0c0));
+    CHECK(0xe0e0c0 == (virtual_panel_get_pixel(35, 5) & 0xe0e0c0));
+}
+#endif /* CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING */
+
+#ifdef CONFIG_HAGL_HAL_DMA_BLIT
+static void
+test_dma_blit(hagl_backend_t *backend)
+{
+    static hagl_color_t pixels[256 * 64];
+    hagl_bitmap_t src;
+    int wrong = 0;
+
+    hagl_bitmap_init(&src, 256, 64, DISPLAY_DEPTH, pixels);
+
+    /* Bitmap can be reused as soon as hagl_blit() returns. */
+    memset(pixels, 0x5a, sizeof(pixels));
+    hagl_blit(backend, 8, 10, &src);
+    memset(pixels, 0, sizeof(pixels));
+    for (uint16_t y = 0; y < 64; y++) {
+        for (uint16_t x = 0; x < 256; x++) {
+            wrong += (0x5a5a != backend->get_pixel(backend, 8 + x, 10 + y));
+        }
+    }
+    CHECK(0 == wrong);
+
+    /* Asynchronous blit is done after waiting. */
+    memset(pixels, 0xa5, sizeof(pixels));
+    hagl_hal_blit_async(backend, 40, 150, &src);
+    hagl_hal_blit_wait(backend);
+    memset(pixels, 0, sizeof(pixels));
+    wrong = 0;
+    for (uint16_t y = 0; y < 64; y++) {
+        for (uint16_t x = 0; x < 256; x++) {
+            wrong += (0xa5a5 != backend->get_pixel(backend, 40 + x, 150 + y));
+        }
+    }
+    CHECK(0 == wrong);
+}
+#endif /* CONFIG_HAGL_HAL_DMA_BLIT */
+
+#ifdef CONFIG_HAGL_HAL_NO_BUFFERING
+static void
+test_scroll(hagl_backend_t *backend)
+{
+    virtual_panel_stats_t stats;
+    uint16_t tfa, vsa;
+
+    virtual_panel_reset_stats();
+    CHECK(ESP_OK == hagl_hal_scroll_area(backend, 20, 200));
+    virtual_panel_get_scroll_area(&tfa, &vsa);
+    CHECK(20 + CONFIG_MIPI_DISPLAY_OFFSET_Y == tfa && 200 == vsa);
+
+    /* Drawing coordinates stay the same while the content moves. */
+    hagl_hal_fill_rect(backend, 0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT, 0x0000);
+    hagl_draw_hline_xyw(backend, 0, 30, DISPLAY_WIDTH, 0xffff);
+    hagl_hal_scroll(backend, 5);
+    CHECK(0 != virtual_panel_get_pixel(7, 25));
+    CHECK(0 == virtual_panel_get_pixel(7, 30));
+
+    hagl_draw_hline_xyw(backend, 0, 219, DISPLAY_WIDTH, 0xffff);
+    CHECK(0 != virtual_panel_get_pixel(7, 219));
+    CHECK(0 == virtual_panel_get_pixel(7, 220));
+
+    /* Wrap around the end of the area. */
+    hagl_hal_scroll(backend, 199);
+    CHECK(20 + CONFIG_MIPI_DISPLAY_OFFSET_Y + 199 == virtual_panel_get_scroll_start());
+    CHECK(0 != virtual_panel_get_pixel(7, 31));
+
+    /* Areas which do not fit are rejected without sending anything. */
+    virtual_panel_reset_stats();
+    CHECK(ESP_ERR_INVALID_ARG == hagl_hal_scroll_area(backend, 100, DISPLAY_HEIGHT));
+    virtual_panel_get_stats(&stats);
+    CHECK(0 == stats.bytes);
+
+    /* Disabling makes the whole memory the scrolling area. */
+    CHECK(ESP_OK == hagl_hal_scroll_area(backend, 0, 0));
+    virtual_panel_get_stats(&stats);
+    virtual_panel_get_scroll_area(&tfa, &vsa);
+    CHECK(0 == tfa && CONFIG_MIPI_DISPLAY_GRAM_HEIGHT == vsa);
+    CHECK(0 == stats.invalid);
+}
+
+/* Read only data stands in for an image in flash, top half white. */
+static const uint16_t asset[64 * 32] = {
+    [0 ... 64 * 16 - 1] = 0xffff,
+    [64 * 16 ... 64 * 32 - 1] = 0x0000,
+};
+
+static void
+test_stream_from_flash(hagl_backend_t *backend)
+{
+    virtual_panel_stats_t stats;
+    hagl_bitmap_t bitmap;
+
+    hagl_bitmap_init(&bitmap, 64, 32, 16, (void *) asset);
+
+    /* Mapped flash is copied through the bounce buffers, never sent as is. */
+    virtual_panel_reset_stats();
+    hagl_blit(backend, 10, 20, &bitmap);
+    virtual_panel_get_stats(&stats);
+
+    CHECK(64 * 32 == stats.pixels);
+    CHECK(0 == stats.external);
+    CHECK(0x000000 != virtual_panel_get_pixel(10, 20));
+    CHECK(0x000000 != virtual_panel_get_pixel(73, 35));
+    CHECK(0x000000 == virtual_panel_get_pixel(10, 36));
+    CHECK(0x000000 == virtual_panel_get_pixel(73, 51));
+}
+#endif /* CONFIG_HAGL_HAL_NO_BUFFERING */
+
+#if defined(CONFIG_MIPI_DISPLAY_TE_SYNC) && CONFIG_MIPI_DISPLAY_PIN_TE >= 0
+static atomic_bool pulsed;
+
+static void *
+te_pulse(void *arg)
+{
+    usleep(5000);
+    atomic_store(&pulsed, true);
+    virtual_panel_te_pulse();
+    return NULL;
+}
+
+static void
+test_te_wait(hagl_backend_t *backend)
+{
+    mipi_display_t *display = hagl_hal_get_display(backend);
+    const int64_t period = 1000000 / CONFIG_MIPI_DISPLAY_REFRESH_RATE;
+    pthread_t thread;
+    int64_t started;
+
+    CHECK(virtual_panel_get_tear_on());
+    CHECK(CONFIG_MIPI_DISPLAY_TE_SCANLINE == virtual_panel_get_tear_scanline());
+
+    /* Returns only after the edge. */
+    atomic_store(&pulsed, false);
+    pthread_create(&thread, NULL, te_pulse, NULL);
+    mipi_display_vsync_wait(display);
+    CHECK(atomic_load(&pulsed));
+    pthread_join(thread, NULL);
+
+    /* Edge which happened before the call is ignored. */
+    virtual_panel_te_pulse();
+    atomic_store(&pulsed, false);
+    pthread_create(&thread, NULL, te_pulse, NULL);
+    mipi_display_vsync_wait(display);
+    CHECK(atomic_load(&pulsed));
+    pthread_join(thread, NULL);
+
+    /* Without edges gives up after two frames. */
+    started = esp_timer_get_time();
+    mipi_display_vsync_wait(display);
+    CHECK(esp_timer_get_time() - started >= 2 * period);
+}
+#endif /* CONFIG_MIPI_DISPLAY_TE_SYNC && CONFIG_MIPI_DISPLAY_PIN_TE >= 0 */
+
+int
+main(void)
+{
+    hagl_backend_t *backend = hagl_init();
+
+    test_clip_rect();
+
+#if defined(CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING) && defined(CONFIG_HAGL_HAL_DIRTY_RECTANGLES)
+    test_dirty_rectangles(backend);
+#endif /* CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING && CONFIG_HAGL_HAL_DIRTY_RECTANGLES */
+
+#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
+    test_snapshot(backend);
+#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
+
+#if defined(CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING) && defined(CONFIG_HAGL_HAL_ROW_HASH)
+    test_row_hash(backend);
+#endif /* CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING && CONFIG_HAGL_HAL_ROW_HASH */
+
+#ifdef CONFIG_HAGL_HAL_COALESCE_PIXELS
+    test_coalesce_pixels(backend);
+#endif /* CONFIG_HAGL_HAL_COALESCE_PIXELS */
+
+#ifdef CONFIG_HAGL_HAL_USE_STRIP_BUFFERING
+    test_strip_render(backend);
+#endif /* CONFIG_HAGL_HAL_USE_STRIP_BUFFERING */
+
+#ifdef CONFIG_HAGL_HAL_USE_TILED_BUFFERING
+    test_tiles(backend);
+#endif /* CONFIG_HAGL_HAL_USE_TILED_BUFFERING */
+
+#ifdef CONFIG_HAGL_HAL_BUFFER_AGE
+    test_buffer_age(backend);
+#endif /* CONFIG_HAGL_HAL_BUFFER_AGE */
+
+#ifdef CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING
+    test_default_palette(backend);
+#endif /* CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING */
+
+#ifdef CONFIG_HAGL_HAL_DMA_BLIT
+    test_dma_blit(backend);
+#endif /* CONFIG_HAGL_HAL_DMA_BLIT */
+
+#ifdef CONFIG_HAGL_HAL_NO_BUFFERING
+    test_transport(backend);
+    test_fences(backend);
+    test_scroll(backend);
+    test_stream_from_flash(backend);
+#endif /* CONFIG_HAGL_HAL_NO_BUFFERING */
+
+#if defined(CONFIG_MIPI_DISPLAY_TE_SYNC) && CONFIG_MIPI_DISPLAY_PIN_TE >= 0
+    test_te_wait(backend);
+#endif /* CONFIG_MIPI_DISPLAY_TE_SYNC && CONFIG_MIPI_DISPLAY_PIN_TE >= 0 */
+
+    hagl_close(backend);
+
+    printf("%d checks, %d failures\n", checks, failures);
+    return failures ? 1 : 0;
+}
@@ -39,35 +39,44 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
 #include <hagl/backend.h>
 
 #include "sdkconfig.h"
 
 #ifdef CONFIG_MIPI_DCS_PIXEL_FORMAT_24BIT_SELECTED
-typedef uint32_t hagl_color_t;
+typedef uint32_t hagl_hal_pixel_t;
 #endif
 
 #ifdef CONFIG_MIPI_DCS_PIXEL_FORMAT_18BIT_SELECTED
-typedef uint32_t hagl_color_t;
+typedef uint32_t hagl_hal_pixel_t;
 #endif
 
 #ifdef CONFIG_MIPI_DCS_PIXEL_FORMAT_16BIT_SELECTED
 /* Currently only this, ie. RGB565 is properly tested. */
-typedef uint16_t hagl_color_t;
+typedef uint16_t hagl_hal_pixel_t;
 #endif
 
 #ifdef CONFIG_MIPI_DCS_PIXEL_FORMAT_12BIT_SELECTED
-typedef uint16_t hagl_color_t;
+typedef uint16_t hagl_hal_pixel_t;
 #endif
 
 #ifdef CONFIG_MIPI_DCS_PIXEL_FORMAT_8BIT_SELECTED
-typedef uint8_t hagl_color_t;
+typedef uint8_t hagl_hal_pixel_t;
 #endif
 
 #ifdef CONFIG_MIPI_DCS_PIXEL_FORMAT_3BIT_SELECTED
-typedef uint8_t hagl_color_t;
+typedef uint8_t hagl_hal_pixel_t;
 #endif
 
+#ifdef CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING
+/* Drawing is done with palette indices. */
+typedef uint8_t hagl_color_t;
+#else
+typedef hagl_hal_pixel_t hagl_color_t;
+#endif /* CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING */
+
 
 #ifdef CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING
 #define HAGL_HAS_HAL_BACK_BUFFER
@@ -81,6 +90,24 @@ typedef uint8_t hagl_color_t;
 #undef HAGL_HAS_HAL_BACK_BUFFER
 #endif
 
+#ifdef CONFIG_HAGL_HAL_USE_STRIP_BUFFERING
+#undef HAGL_HAS_HAL_BACK_BUFFER
+#endif
+
+#ifdef CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING
+#define HAGL_HAS_HAL_BACK_BUFFER
+#endif
+
+#ifdef CONFIG_HAGL_HAL_USE_TILED_BUFFERING
+#undef HAGL_HAS_HAL_BACK_BUFFER
+#endif
+
+#ifdef CONFIG_HAGL_HAL_BACK_BUFFER_PSRAM
+#define HAGL_HAL_BACK_BUFFER_CAPS   (MALLOC_CAP_SPIRAM | MALLOC_CAP_32BIT)
+#else
+#define HAGL_HAL_BACK_BUFFER_CAPS   (MALLOC_CAP_DMA | MALLOC_CAP_32BIT)
+#endif /* CONFIG_HAGL_HAL_BACK_BUFFER_PSRAM */
+
 #define DISPLAY_WIDTH       (CONFIG_MIPI_DISPLAY_WIDTH)
 #define DISPLAY_HEIGHT      (CONFIG_MIPI_DISPLAY_HEIGHT)
 #define DISPLAY_DEPTH       (CONFIG_MIPI_DISPLAY_DEPTH)
@@ -93,6 +120,184 @@ typedef uint8_t hagl_color_t;
  */
 void hagl_hal_init(hagl_backend_t *backend);
 
+struct mipi_display;
+
+/**
+ * Return the display the backend draws to
+ */
+struct mipi_display *hagl_hal_get_display(hagl_backend_t *backend);
+
+#ifdef CONFIG_HAGL_HAL_NO_BUFFERING
+/**
+ * Initialize the HAL for an additional display
+ *
+ * Display must be initialized with mipi_display_init() first. Each
+ * display needs its own SPI host. Backends of different displays can
+ * be drawn to from different tasks at the same time.
+ */
+void hagl_hal_init_display(hagl_backend_t *backend, struct mipi_display *display);
+#endif /* CONFIG_HAGL_HAL_NO_BUFFERING */
+
+/**
+ * Fill a rectangle with a single color
+ *
+ * Rectangle is clipped to the current clip window. Unlike drawing one
+ * line at a time without back buffer the address window is set only
+ * once.
+ */
+void hagl_hal_fill_rect(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_color_t color);
+
+/**
+ * Fill the current clip window with black
+ */
+void hagl_hal_clear(hagl_backend_t *backend);
+
+/**
+ * Clip a rectangle to the given window
+ *
+ * Returns false if nothing is left after clipping.
+ */
+bool hagl_hal_clip_rect(const hagl_window_t *clip, int16_t *x0, int16_t *y0, uint16_t *w, uint16_t *h);
+
+/**
+ * Fill a rectangle of a bitmap using word wide stores
+ *
+ * Coordinates are not clipped.
+ */
+void hagl_hal_fill_bitmap(hagl_bitmap_t *bitmap, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_color_t color);
+
+/**
+ * Show only the given area to save power
+ *
+ * Display enters partial mode and drawing is clipped to the area.
+ * Flushes send only the rows of the area. With idle the display also
+ * reduces the number of colors.
+ */
+void hagl_hal_standby(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, bool idle);
+
+/**
+ * Return from standby to showing the whole display
+ */
+void hagl_hal_wake(hagl_backend_t *backend);
+
+#if defined(CONFIG_HAGL_HAL_USE_TRIPLE_BUFFERING) || defined(CONFIG_HAGL_HAL_INDEXED_TWO_BUFFERS)
+typedef struct {
+    uint32_t presented;
+    uint32_t dropped;
+} hagl_hal_frame_stats_t;
+
+/**
+ * Get the number of presented and dropped frames
+ */
+void hagl_hal_get_frame_stats(hagl_hal_frame_stats_t *stats);
+
+/**
+ * Reset the presented and dropped frame counters
+ */
+void hagl_hal_reset_frame_stats(void);
+#endif /* CONFIG_HAGL_HAL_USE_TRIPLE_BUFFERING || CONFIG_HAGL_HAL_INDEXED_TWO_BUFFERS */
+
+#ifdef CONFIG_HAGL_HAL_BUFFER_AGE
+/**
+ * Return the age of the back buffer
+ *
+ * Zero means the content is undefined and everything must be drawn.
+ * One means the back buffer holds the previous frame. N means it holds
+ * the frame from N frames ago.
+ */
+uint8_t hagl_hal_buffer_age(hagl_backend_t *backend);
+
+/**
+ * Get the areas where the back buffer differs from the previous frame
+ *
+ * Areas array must have room for HAGL_HAL_DAMAGE_RECTANGLES_MAX areas.
+ * Returns the number of areas. These are the areas drawn to the newer
+ * frames. Note that redrawing them also counts as drawing.
+ */
+uint8_t hagl_hal_get_damage(hagl_backend_t *backend, hagl_window_t *areas);
+
+/**
+ * Copy the damaged areas from the previous frame to the back buffer
+ *
+ * Afterwards the back buffer holds the previous frame and only the
+ * changes of the next frame need to be drawn.
+ */
+void hagl_hal_copy_damage(hagl_backend_t *backend);
+#endif /* CONFIG_HAGL_HAL_BUFFER_AGE */
+
+#ifdef CONFIG_HAGL_HAL_DMA_BLIT
+/**
+ * Blit a bitmap to the back buffer without waiting for DMA
+ *
+ * Same as hagl_blit() but returns while DMA is still reading the bitmap.
+ * The bitmap must not be changed or freed before the next flush or
+ * hagl_hal_blit_wait(). Small and partially visible bitmaps are copied
+ * with CPU before returning.
+ */
+void hagl_hal_blit_async(hagl_backend_t *backend, int16_t x0, int16_t y0, hagl_bitmap_t *src);
+
+/**
+ * Wait until blits copied with DMA are in the back buffer
+ *
+ * Call this before changing or freeing a bitmap passed to
+ * hagl_hal_blit_async(). Flush waits for the copies too.
+ */
+void hagl_hal_blit_wait(hagl_backend_t *backend);
+#endif /* CONFIG_HAGL_HAL_DMA_BLIT */
+
+#ifdef CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING
+/**
+ * Set palette entries
+ *
+ * Changes count entries starting from first. Colors are in the format
+ * sent to the display. New palette is used starting from the next
+ * flush, which makes palette cycling effects free.
+ */
+void hagl_hal_set_palette(uint8_t first, uint16_t count, const hagl_hal_pixel_t *colors);
+#endif /* CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING */
+
+#ifdef CONFIG_HAGL_HAL_NO_BUFFERING
+/**
+ * Set the hardware vertical scrolling area
+ *
+ * Rows above and below the area stay fixed. Height of zero disables
+ * scrolling. Returns ESP_ERR_INVALID_ARG if the area does not fit the
+ * display.
+ */
+esp_err_t hagl_hal_scroll_area(hagl_backend_t *backend, uint16_t top, uint16_t height);
+
+/**
+ * Scroll the content of the scrolling area up by offset rows
+ *
+ * Only a few bytes are sent. Drawing coordinates stay the same, rows
+ * scrolled in from the bottom are drawn at the bottom of the area.
+ */
+void hagl_hal_scroll(hagl_backend_t *backend, uint16_t offset);
+#endif /* CONFIG_HAGL_HAL_NO_BUFFERING */
+
+#ifdef CONFIG_HAGL_HAL_USE_STRIP_BUFFERING
+typedef void (*hagl_hal_draw_t)(hagl_backend_t *backend, void *user);
+
+/**
+ * Render the screen one strip at a time
+ *
+ * Drawing callback is called once per strip with the clip window set
+ * to the strip. Callback must draw the whole scene every time. Returns
+ * the number of bytes sent to the display.
+ */
+size_t hagl_hal_render(hagl_backend_t *backend, hagl_hal_draw_t draw, void *user);
+#endif /* CONFIG_HAGL_HAL_USE_STRIP_BUFFERING */
+
+#ifdef CONFIG_HAGL_HAL_BENCHMARK
+/**
+ * Measure the speed of each backend operation
+ *
+ * Each operation is run for the given duration. Results are printed
+ * as one JSON object per line.
+ */
+void hagl_hal_benchmark(hagl_backend_t *backend, uint32_t duration_ms);
+#endif /* CONFIG_HAGL_HAL_BENCHMARK */
+
 #ifdef __cplusplus
 }
 #endif
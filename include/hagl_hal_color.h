@@ -40,7 +40,14 @@ extern "C" {
 
 #include <stdint.h>
 
+#include "sdkconfig.h"
+
+#ifdef CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING
+/* Colors are indices to the palette. */
+typedef uint8_t hagl_color_t;
+#else
 typedef uint16_t hagl_color_t;
+#endif /* CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING */
 
 #ifdef __cplusplus
 }
@@ -43,7 +43,13 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <driver/spi_master.h>
+#ifdef CONFIG_MIPI_DISPLAY_TRANSPORT_I80
+#include <esp_lcd_panel_io.h>
+#endif /* CONFIG_MIPI_DISPLAY_TRANSPORT_I80 */
 
 #include "sdkconfig.h"
 #include "hagl_hal.h"
@@ -54,6 +60,13 @@ extern "C" {
 #define SPI_MAX_TRANSFER_SIZE   (4092)
 #endif
 
+/* Fill pattern, multiple of every supported pixel size. */
+#define MIPI_DISPLAY_PATTERN_SIZE   (768)
+
+/* Enough transactions to queue address window and a full frame at once. */
+#define MIPI_DISPLAY_QUEUE_SIZE \
+    (DISPLAY_WIDTH * DISPLAY_HEIGHT * DISPLAY_DEPTH / 8 / SPI_MAX_TRANSFER_SIZE + 6)
+
 #define MIPI_DISPLAY_ADDRESS_MODE ( \
     CONFIG_MIPI_DCS_ADDRESS_MODE_MIRROR_Y | \
     CONFIG_MIPI_DCS_ADDRESS_MODE_MIRROR_X | \
@@ -63,10 +76,257 @@ extern "C" {
     CONFIG_MIPI_DCS_ADDRESS_MODE_BGR \
 )
 
-void mipi_display_init(spi_device_handle_t *spi);
-size_t mipi_display_write(spi_device_handle_t spi, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, const uint8_t *buffer);
-void mipi_display_ioctl(spi_device_handle_t spi, uint8_t command, uint8_t *data, size_t size);
-void mipi_display_close(spi_device_handle_t spi);
+#ifdef CONFIG_MIPI_DISPLAY_TE_SYNC
+#define MIPI_DISPLAY_PIN_TE (CONFIG_MIPI_DISPLAY_PIN_TE)
+#else
+#define MIPI_DISPLAY_PIN_TE (-1)
+#endif /* CONFIG_MIPI_DISPLAY_TE_SYNC */
+
+#ifdef CONFIG_MIPI_DISPLAY_QSPI
+#define MIPI_DISPLAY_PIN_QUADWP (CONFIG_MIPI_DISPLAY_PIN_QUADWP)
+#define MIPI_DISPLAY_PIN_QUADHD (CONFIG_MIPI_DISPLAY_PIN_QUADHD)
+#else
+#define MIPI_DISPLAY_PIN_QUADWP (-1)
+#define MIPI_DISPLAY_PIN_QUADHD (-1)
+#endif /* CONFIG_MIPI_DISPLAY_QSPI */
+
+#if CONFIG_MIPI_DISPLAY_I80_BUS_WIDTH == 16
+#define MIPI_DISPLAY_PIN_DATA { \
+    CONFIG_MIPI_DISPLAY_PIN_D0, CONFIG_MIPI_DISPLAY_PIN_D1, \
+    CONFIG_MIPI_DISPLAY_PIN_D2, CONFIG_MIPI_DISPLAY_PIN_D3, \
+    CONFIG_MIPI_DISPLAY_PIN_D4, CONFIG_MIPI_DISPLAY_PIN_D5, \
+    CONFIG_MIPI_DISPLAY_PIN_D6, CONFIG_MIPI_DISPLAY_PIN_D7, \
+    CONFIG_MIPI_DISPLAY_PIN_D8, CONFIG_MIPI_DISPLAY_PIN_D9, \
+    CONFIG_MIPI_DISPLAY_PIN_D10, CONFIG_MIPI_DISPLAY_PIN_D11, \
+    CONFIG_MIPI_DISPLAY_PIN_D12, CONFIG_MIPI_DISPLAY_PIN_D13, \
+    CONFIG_MIPI_DISPLAY_PIN_D14, CONFIG_MIPI_DISPLAY_PIN_D15 \
+}
+#elif CONFIG_MIPI_DISPLAY_I80_BUS_WIDTH == 8
+#define MIPI_DISPLAY_PIN_DATA { \
+    CONFIG_MIPI_DISPLAY_PIN_D0, CONFIG_MIPI_DISPLAY_PIN_D1, \
+    CONFIG_MIPI_DISPLAY_PIN_D2, CONFIG_MIPI_DISPLAY_PIN_D3, \
+    CONFIG_MIPI_DISPLAY_PIN_D4, CONFIG_MIPI_DISPLAY_PIN_D5, \
+    CONFIG_MIPI_DISPLAY_PIN_D6, CONFIG_MIPI_DISPLAY_PIN_D7 \
+}
+#endif /* CONFIG_MIPI_DISPLAY_I80_BUS_WIDTH */
+
+#ifdef CONFIG_MIPI_DISPLAY_INVERT
+#define MIPI_DISPLAY_INVERT (true)
+#else
+#define MIPI_DISPLAY_INVERT (false)
+#endif /* CONFIG_MIPI_DISPLAY_INVERT */
+
+/* Pins and geometry of one display. Pixel depth is shared by all. */
+typedef struct {
+    spi_host_device_t host;
+    int8_t pin_miso;
+    int8_t pin_mosi;
+    int8_t pin_clk;
+    /* Data lines 2 and 3 of quad SPI panels, -1 for normal SPI. */
+    int8_t pin_quadwp;
+    int8_t pin_quadhd;
+    /* Write strobe, read strobe and data lines of i80 bus. */
+    int8_t pin_wr;
+    int8_t pin_rd;
+    int8_t pin_data[16];
+    uint8_t bus_width;
+    int8_t pin_cs;
+    int8_t pin_dc;
+    int8_t pin_rst;
+    int8_t pin_bl;
+    int8_t pin_bl_active;
+    int8_t pin_te;
+    /* Backlight PWM duty cycle and LEDC channel, -1 disables PWM. */
+    int16_t pwm_bl;
+    uint8_t pwm_channel;
+    uint32_t clock_speed_hz;
+    uint8_t spi_mode;
+    uint16_t width;
+    uint16_t height;
+    uint16_t offset_x;
+    uint16_t offset_y;
+    uint16_t gram_height;
+    uint8_t address_mode;
+    uint8_t pixel_format;
+    bool invert;
+    /* Size of the two bounce buffers for PSRAM or flash data, 0 disables. */
+    uint32_t bounce_size;
+} mipi_display_config_t;
+
+#ifdef CONFIG_MIPI_DISPLAY_TRANSPORT_I80
+/* No MISO on parallel bus, scanline cannot be read. */
+#define MIPI_DISPLAY_BUS_CONFIG_DEFAULT \
+    .pin_miso = -1, \
+    .pin_mosi = -1, \
+    .pin_clk = -1, \
+    .pin_quadwp = -1, \
+    .pin_quadhd = -1, \
+    .pin_wr = CONFIG_MIPI_DISPLAY_PIN_WR, \
+    .pin_rd = CONFIG_MIPI_DISPLAY_PIN_RD, \
+    .pin_data = MIPI_DISPLAY_PIN_DATA, \
+    .bus_width = CONFIG_MIPI_DISPLAY_I80_BUS_WIDTH, \
+    .clock_speed_hz = CONFIG_MIPI_DISPLAY_I80_CLOCK_SPEED_HZ
+#else
+#define MIPI_DISPLAY_BUS_CONFIG_DEFAULT \
+    .host = CONFIG_MIPI_DISPLAY_SPI_HOST, \
+    .pin_miso = CONFIG_MIPI_DISPLAY_PIN_MISO, \
+    .pin_mosi = CONFIG_MIPI_DISPLAY_PIN_MOSI, \
+    .pin_clk = CONFIG_MIPI_DISPLAY_PIN_CLK, \
+    .pin_quadwp = MIPI_DISPLAY_PIN_QUADWP, \
+    .pin_quadhd = MIPI_DISPLAY_PIN_QUADHD, \
+    .pin_wr = -1, \
+    .pin_rd = -1, \
+    .clock_speed_hz = CONFIG_MIPI_DISPLAY_SPI_CLOCK_SPEED_HZ, \
+    .spi_mode = CONFIG_MIPI_DISPLAY_SPI_MODE
+#endif /* CONFIG_MIPI_DISPLAY_TRANSPORT_I80 */
+
+/* Display configured with menuconfig. */
+#define MIPI_DISPLAY_CONFIG_DEFAULT() { \
+    MIPI_DISPLAY_BUS_CONFIG_DEFAULT, \
+    .pin_cs = CONFIG_MIPI_DISPLAY_PIN_CS, \
+    .pin_dc = CONFIG_MIPI_DISPLAY_PIN_DC, \
+    .pin_rst = CONFIG_MIPI_DISPLAY_PIN_RST, \
+    .pin_bl = CONFIG_MIPI_DISPLAY_PIN_BL, \
+    .pin_bl_active = CONFIG_MIPI_DISPLAY_PIN_BL_ACTIVE, \
+    .pin_te = MIPI_DISPLAY_PIN_TE, \
+    .pwm_bl = CONFIG_MIPI_DISPLAY_PWM_BL, \
+    .pwm_channel = 0, \
+    .width = CONFIG_MIPI_DISPLAY_WIDTH, \
+    .height = CONFIG_MIPI_DISPLAY_HEIGHT, \
+    .offset_x = CONFIG_MIPI_DISPLAY_OFFSET_X, \
+    .offset_y = CONFIG_MIPI_DISPLAY_OFFSET_Y, \
+    .gram_height = CONFIG_MIPI_DISPLAY_GRAM_HEIGHT, \
+    .address_mode = MIPI_DISPLAY_ADDRESS_MODE, \
+    .pixel_format = CONFIG_MIPI_DISPLAY_PIXEL_FORMAT, \
+    .invert = MIPI_DISPLAY_INVERT, \
+    .bounce_size = CONFIG_MIPI_DISPLAY_BOUNCE_SIZE, \
+}
+
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+typedef struct {
+    /* DCS commands sent. */
+    uint32_t commands;
+    /* Data bytes sent, including command parameters. */
+    uint64_t data_bytes;
+    uint32_t polling_transactions;
+    uint32_t queued_transactions;
+    /* Column and page address changes skipped or sent. */
+    uint32_t address_hits;
+    uint32_t address_misses;
+    /* Time spent waiting for the display lock. */
+    uint64_t lock_wait_us;
+    /* Latency of pixel writes from call until sent. */
+    uint32_t flushes;
+    uint32_t flush_min_us;
+    uint32_t flush_max_us;
+    uint64_t flush_total_us;
+    /* Bytes copied to bounce buffers before sending. */
+    uint64_t bounced_bytes;
+} mipi_display_stats_t;
+
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
+
+struct mipi_display;
+
+/* Level of the DC pin and fence of a transaction, used when it is done. */
+typedef struct {
+    struct mipi_display *display;
+    uint8_t dc;
+    uint32_t fence;
+} mipi_display_user_t;
+
+/* State of one display, fields are private to the driver. */
+typedef struct mipi_display {
+    mipi_display_config_t config;
+#ifdef CONFIG_MIPI_DISPLAY_TRANSPORT_I80
+    esp_lcd_i80_bus_handle_t bus;
+    esp_lcd_panel_io_handle_t io;
+#else
+    spi_device_handle_t spi;
+#endif /* CONFIG_MIPI_DISPLAY_TRANSPORT_I80 */
+    /* Binary semaphore so it can be released from the transfer done callback. */
+    SemaphoreHandle_t mutex;
+#ifndef CONFIG_MIPI_DISPLAY_TRANSPORT_I80
+    mipi_display_user_t command_user;
+    mipi_display_user_t data_user;
+#endif /* CONFIG_MIPI_DISPLAY_TRANSPORT_I80 */
+
+    /* Ring of queued transactions, oldest one is done first. */
+#ifdef CONFIG_MIPI_DISPLAY_TRANSPORT_I80
+    mipi_display_user_t users[MIPI_DISPLAY_QUEUE_SIZE];
+    size_t head;
+    /* Oldest transaction in flight and number of those done, advanced in ISR. */
+    volatile size_t tail;
+    volatile uint32_t completed;
+    /* Given whenever a transaction is done. */
+    SemaphoreHandle_t done;
+#else
+    spi_transaction_t transactions[MIPI_DISPLAY_QUEUE_SIZE];
+    mipi_display_user_t users[MIPI_DISPLAY_QUEUE_SIZE];
+    size_t head;
+    size_t queued;
+#endif /* CONFIG_MIPI_DISPLAY_TRANSPORT_I80 */
+    /* Number of transactions ever queued. */
+    uint32_t sequence;
+    uint32_t fence_submitted;
+    volatile uint32_t fence_completed;
+
+    /* Command sent with the next parameters or pixel data on QSPI and i80. */
+    uint8_t command;
+
+    /* Small DMA capable buffer repeated to fill rectangles. */
+    uint8_t *pattern;
+
+    /* Internal buffers and sequence of the transaction last sending them. */
+    uint8_t *bounce[2];
+    uint32_t bounce_sequence[2];
+    uint8_t bounce_next;
+
+    /* Last address window sent. */
+    uint16_t prev_x1, prev_x2, prev_y1, prev_y2;
+
+    /* Vertical scroll area and offset in display coordinates. */
+    uint16_t scroll_top;
+    uint16_t scroll_height;
+    uint16_t scroll_offset;
+
+    /* Rows shown by the display, all of them unless in partial mode. */
+    uint16_t partial_y1;
+    uint16_t partial_y2;
+
+#ifdef CONFIG_MIPI_DISPLAY_TE_SYNC
+    /* Given on every rising edge of the TE pin. */
+    SemaphoreHandle_t tear;
+    int64_t paced_at;
+#endif /* CONFIG_MIPI_DISPLAY_TE_SYNC */
+
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+    mipi_display_stats_t stats;
+    int64_t flush_started;
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
+} mipi_display_t;
+
+void mipi_display_init(mipi_display_t *display, const mipi_display_config_t *config);
+size_t mipi_display_write(mipi_display_t *display, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, const uint8_t *buffer);
+size_t mipi_display_fill(mipi_display_t *display, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, const uint8_t *color);
+size_t mipi_display_write_changed(mipi_display_t *display, uint16_t y1, uint16_t h, const uint8_t *buffer, uint32_t *hashes, bool force);
+size_t mipi_display_write_region(mipi_display_t *display, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, uint16_t pitch, const uint8_t *buffer);
+uint32_t mipi_display_write_async(mipi_display_t *display, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, const uint8_t *buffer);
+bool mipi_display_fence_done(mipi_display_t *display, uint32_t fence);
+void mipi_display_fence_wait(mipi_display_t *display, uint32_t fence);
+void mipi_display_vsync_wait(mipi_display_t *display);
+esp_err_t mipi_display_set_scroll_area(mipi_display_t *display, uint16_t top, uint16_t height);
+void mipi_display_set_scroll_offset(mipi_display_t *display, uint16_t offset);
+void mipi_display_enter_partial(mipi_display_t *display, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, bool idle);
+void mipi_display_exit_partial(mipi_display_t *display);
+void mipi_display_get_partial(mipi_display_t *display, uint16_t *y1, uint16_t *y2);
+void mipi_display_ioctl(mipi_display_t *display, uint8_t command, uint8_t *data, size_t size);
+void mipi_display_close(mipi_display_t *display);
+
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+void mipi_display_stats_get(mipi_display_t *display, mipi_display_stats_t *stats);
+void mipi_display_stats_reset(mipi_display_t *display);
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,278 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Measures the speed of each backend operation in the configured buffering
+mode. Results are printed one JSON object per line so they can be
+collected and compared between releases. When built for Linux the
+traffic is counted by the virtual panel and modelled wire time is
+included.
+
+*/
+
+#include "sdkconfig.h"
+#include "hagl_hal.h"
+
+#ifdef CONFIG_HAGL_HAL_BENCHMARK
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <esp_timer.h>
+#include <mipi_display.h>
+#include <hagl/bitmap.h>
+#include <hagl.h>
+
+#ifdef CONFIG_IDF_TARGET_LINUX
+#include "virtual_panel.h"
+#endif /* CONFIG_IDF_TARGET_LINUX */
+
+#define BATCH_SIZE  (16)
+#define SPRITE_SIZE (16)
+
+#if defined(CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING)
+static const char *mode = "double";
+#elif defined(CONFIG_HAGL_HAL_USE_TRIPLE_BUFFERING)
+static const char *mode = "triple";
+#elif defined(CONFIG_HAGL_HAL_USE_STRIP_BUFFERING)
+static const char *mode = "strip";
+#elif defined(CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING)
+static const char *mode = "indexed";
+#elif defined(CONFIG_HAGL_HAL_USE_TILED_BUFFERING)
+static const char *mode = "tiled";
+#else
+static const char *mode = "single";
+#endif
+
+typedef enum {
+    OP_PUT_PIXEL,
+    OP_HLINE,
+    OP_VLINE,
+    OP_BLIT,
+    OP_SCALE_BLIT,
+    OP_FILL_RECT,
+    OP_FLUSH,
+} benchmark_op_t;
+
+static const char *names[] = {
+    "put_pixel",
+    "hline",
+    "vline",
+    "blit",
+    "scale_blit",
+    "fill_rect",
+    "flush",
+};
+
+typedef struct {
+    uint32_t transactions;
+    uint64_t bytes;
+    uint64_t wire_ns;
+    /* False when the counters are not available. */
+    bool valid;
+} benchmark_counters_t;
+
+static uint8_t sprite_buffer[BITMAP_SIZE(SPRITE_SIZE, SPRITE_SIZE, DISPLAY_DEPTH)] __attribute__((aligned(4)));
+static hagl_bitmap_t sprite;
+static uint32_t seed;
+
+/* Deterministic xorshift so that runs are comparable. */
+static uint32_t
+next(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static void
+counters(hagl_backend_t *display, benchmark_counters_t *counters)
+{
+#ifdef CONFIG_IDF_TARGET_LINUX
+    virtual_panel_stats_t stats;
+
+    (void) display;
+    virtual_panel_get_stats(&stats);
+    counters->transactions = stats.transactions;
+    counters->bytes = stats.bytes;
+    counters->wire_ns = stats.wire_ns;
+    counters->valid = true;
+#elif defined(CONFIG_MIPI_DISPLAY_STATS)
+    mipi_display_t *mipi = hagl_hal_get_display(display);
+    mipi_display_stats_t stats;
+
+    /* Wire time is estimated from the configured clock. */
+    mipi_display_stats_get(mipi, &stats);
+    counters->transactions = stats.polling_transactions + stats.queued_transactions;
+    counters->bytes = stats.commands + stats.data_bytes;
+#ifdef CONFIG_MIPI_DISPLAY_TRANSPORT_I80
+    /* Parallel bus writes bus width bits on each clock. */
+    counters->wire_ns = counters->bytes * 8 * 1000000000ULL / mipi->config.bus_width / mipi->config.clock_speed_hz;
+#else
+    counters->wire_ns = counters->bytes * 8 * 1000000000ULL / mipi->config.clock_speed_hz;
+#endif /* CONFIG_MIPI_DISPLAY_TRANSPORT_I80 */
+    counters->valid = true;
+#else
+    (void) display;
+    counters->transactions = 0;
+    counters->bytes = 0;
+    counters->wire_ns = 0;
+    counters->valid = false;
+#endif /* CONFIG_IDF_TARGET_LINUX */
+}
+
+static void
+run(hagl_backend_t *display, benchmark_op_t op)
+{
+    const uint16_t width = display->width;
+    const uint16_t height = display->height;
+
+    for (uint16_t i = 0; i < BATCH_SIZE; i++) {
+        int16_t x0 = next() % width;
+        int16_t y0 = next() % height;
+        hagl_color_t color = next();
+
+        switch (op) {
+            case OP_PUT_PIXEL:
+                hagl_put_pixel(display, x0, y0, color);
+                break;
+            case OP_HLINE:
+                hagl_draw_hline_xyw(display, 0, y0, width, color);
+                break;
+            case OP_VLINE:
+                hagl_draw_vline_xyh(display, x0, 0, height, color);
+                break;
+            case OP_BLIT:
+                hagl_blit_xy(display, x0 % (width - SPRITE_SIZE), y0 % (height - SPRITE_SIZE), &sprite);
+                break;
+            case OP_SCALE_BLIT:
+                hagl_blit_xywh(display, x0 % (width / 2), y0 % (height / 2), width / 2, height / 2, &sprite);
+                break;
+            case OP_FILL_RECT:
+                hagl_hal_fill_rect(display, x0 % (width / 2), y0 % (height / 2), width / 2, height / 2, color);
+                break;
+            case OP_FLUSH:
+                hagl_flush(display);
+                break;
+        }
+    }
+}
+
+#ifdef CONFIG_HAGL_HAL_USE_STRIP_BUFFERING
+static void
+draw(hagl_backend_t *display, void *user)
+{
+    run(display, *(benchmark_op_t *) user);
+}
+#endif /* CONFIG_HAGL_HAL_USE_STRIP_BUFFERING */
+
+static void
+batch(hagl_backend_t *display, benchmark_op_t op)
+{
+#ifdef CONFIG_HAGL_HAL_USE_STRIP_BUFFERING
+    /* Drawing happens inside the render call which is also the flush. */
+    if (OP_FLUSH == op) {
+        for (uint16_t i = 0; i < BATCH_SIZE; i++) {
+            hagl_hal_render(display, draw, &(benchmark_op_t) {OP_PUT_PIXEL});
+        }
+    } else {
+        hagl_hal_render(display, draw, &op);
+    }
+#elif defined(CONFIG_HAGL_HAL_USE_TILED_BUFFERING)
+    /* Operations are only recorded, rasterizing happens when flushing. */
+    if (OP_FLUSH == op) {
+        for (uint16_t i = 0; i < BATCH_SIZE; i++) {
+            hagl_hal_clear(display);
+            hagl_flush(display);
+        }
+    } else {
+        run(display, op);
+        hagl_flush(display);
+    }
+#else
+    run(display, op);
+#endif /* CONFIG_HAGL_HAL_USE_STRIP_BUFFERING */
+}
+
+void
+hagl_hal_benchmark(hagl_backend_t *display, uint32_t duration_ms)
+{
+    benchmark_counters_t start, end;
+
+    hagl_bitmap_init(&sprite, SPRITE_SIZE, SPRITE_SIZE, display->depth, sprite_buffer);
+    for (size_t i = 0; i < sizeof(sprite_buffer); i++) {
+        sprite_buffer[i] = i;
+    }
+
+    for (benchmark_op_t op = OP_PUT_PIXEL; op <= OP_FLUSH; op++) {
+        uint32_t ops = 0;
+        seed = 0x2545f491;
+
+        /* Make sure previous operation does not affect the results. */
+        hagl_flush(display);
+
+        counters(display, &start);
+        int64_t started = esp_timer_get_time();
+        int64_t elapsed;
+
+        /* At least one batch so that the averages are defined. */
+        do {
+            batch(display, op);
+            ops += BATCH_SIZE;
+            elapsed = esp_timer_get_time() - started;
+        } while (elapsed < (int64_t) duration_ms * 1000);
+
+        counters(display, &end);
+
+        printf(
+            "{\"mode\": \"%s\", \"op\": \"%s\", \"ops\": %" PRIu32 ", "
+            "\"ops_per_sec\": %.1f, \"us_per_op\": %.3f",
+            mode, names[op], ops,
+            ops * 1000000.0 / elapsed, (double) elapsed / ops
+        );
+        if (start.valid) {
+            printf(
+                ", \"bytes_per_op\": %.1f, \"transactions_per_op\": %.3f, \"wire_us_per_op\": %.3f",
+                (double) (end.bytes - start.bytes) / ops,
+                (double) (end.transactions - start.transactions) / ops,
+                (end.wire_ns - start.wire_ns) / 1000.0 / ops
+            );
+        } else {
+            printf(", \"bytes_per_op\": null, \"transactions_per_op\": null, \"wire_us_per_op\": null");
+        }
+        printf("}\n");
+    }
+}
+
+#endif /* CONFIG_HAGL_HAL_BENCHMARK */
@@ -0,0 +1,242 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Blits to the back buffer copied with async memcpy DMA. Each row of the
+source is queued as one copy, or the whole bitmap as one copy when the
+rows are contiguous in both. Plain blits wait for their copies, with
+hagl_hal_blit_async() CPU continues drawing while DMA copies. Bounding box of the copies in flight is kept so that drawing which
+touches it waits for the copies first.
+
+Blits whose copies would be smaller than HAGL_HAL_DMA_BLIT_MIN_SIZE,
+which convert depth, are unaligned or are not in DMA capable memory
+return false and are copied by the caller with CPU.
+
+*/
+
+#include "sdkconfig.h"
+#include "hagl_hal.h"
+
+#ifdef CONFIG_HAGL_HAL_DMA_BLIT
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_attr.h>
+#include <esp_idf_version.h>
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include <esp_memory_utils.h>
+#else
+#include <soc/soc_memory_layout.h>
+#endif
+#include <esp_async_memcpy.h>
+#include <string.h>
+#include <stdbool.h>
+#include <hagl/bitmap.h>
+
+#include "hagl_hal_pixel.h"
+
+/* Handle was renamed in ESP-IDF v5.1. */
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 1, 0)
+typedef async_memcpy_t async_memcpy_handle_t;
+#endif
+
+/* Copies in flight at most, a tall bitmap is queued without waiting. */
+#define DMA_BACKLOG (64)
+
+static const char *TAG = "hagl_esp_mipi";
+
+static async_memcpy_handle_t dma = NULL;
+static SemaphoreHandle_t done;
+static uint32_t submitted = 0;
+static volatile uint32_t completed = 0;
+
+hagl_window_t hagl_hal_dma_pending = {
+    .x0 = UINT16_MAX, .y0 = UINT16_MAX, .x1 = 0, .y1 = 0
+};
+
+static bool IRAM_ATTR
+dma_done(async_memcpy_handle_t handle, async_memcpy_event_t *event, void *args)
+{
+    BaseType_t woken = pdFALSE;
+
+    (void) handle;
+    (void) event;
+    (void) args;
+
+    completed++;
+    xSemaphoreGiveFromISR(done, &woken);
+    return pdTRUE == woken;
+}
+
+/* Waits until all copies up to and including the given one are done. */
+static void
+dma_wait(uint32_t sequence)
+{
+    while ((int32_t) (completed - sequence) < 0) {
+        xSemaphoreTake(done, portMAX_DELAY);
+    }
+}
+
+static bool
+dma_copy(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    /* Backlog is full, wait for the oldest copy. */
+    dma_wait(submitted + 1 - DMA_BACKLOG);
+
+    submitted++;
+    if (ESP_OK != esp_async_memcpy(dma, dst, (void *) src, size, dma_done, NULL)) {
+        submitted--;
+        return false;
+    }
+    return true;
+}
+
+/* Rows follow each other in both, the bitmap can be copied at once. */
+static bool
+dma_contiguous(hagl_bitmap_t *bitmap, hagl_bitmap_t *src)
+{
+    const size_t line = src->width * src->depth / 8;
+
+    return line == src->pitch && line == bitmap->pitch;
+}
+
+static bool
+dma_suitable(hagl_bitmap_t *bitmap, const uint8_t *dst, hagl_bitmap_t *src)
+{
+    const size_t line = src->width * src->depth / 8;
+    const size_t size = dma_contiguous(bitmap, src) ? line * src->height : line;
+
+    if (NULL == dma || src->depth != bitmap->depth) {
+        return false;
+    }
+
+    /*
+     * Each copy must be big enough to be worth setting up. Narrow bitmaps
+     * would be many tiny copies, glyphs are often on stack too.
+     */
+    if (size < CONFIG_HAGL_HAL_DMA_BLIT_MIN_SIZE) {
+        return false;
+    }
+
+    if (!esp_ptr_dma_capable(src->buffer) || !esp_ptr_dma_capable(dst)) {
+        return false;
+    }
+
+    /* DMA moves whole words. */
+    return 0 == (((uintptr_t) dst | (uintptr_t) src->buffer | line | src->pitch | bitmap->pitch) & 3);
+}
+
+bool
+hagl_hal_dma_blit(hagl_bitmap_t *bitmap, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+{
+    const size_t line = src->width * src->depth / 8;
+    uint8_t *dst = bitmap->buffer + y0 * bitmap->pitch + x0 * bitmap->depth / 8;
+    const uint8_t *from = src->buffer;
+    hagl_window_t *pending = &hagl_hal_dma_pending;
+
+    if (!dma_suitable(bitmap, dst, src)) {
+        return false;
+    }
+
+    /* Copies land in the order they were queued, no need to wait here. */
+    if (pending->x0 > x0) {
+        pending->x0 = x0;
+    }
+    if (pending->y0 > y0) {
+        pending->y0 = y0;
+    }
+    if (pending->x1 < x0 + src->width - 1) {
+        pending->x1 = x0 + src->width - 1;
+    }
+    if (pending->y1 < y0 + src->height - 1) {
+        pending->y1 = y0 + src->height - 1;
+    }
+
+    if (dma_contiguous(bitmap, src)) {
+        if (dma_copy(dst, from, line * src->height)) {
+            return true;
+        }
+        hagl_hal_dma_wait_all();
+        memcpy(dst, from, line * src->height);
+        return true;
+    }
+
+    for (int16_t y = 0; y < src->height; y++) {
+        if (!dma_copy(dst, from, line)) {
+            /* Out of descriptors, copy rest of the rows with CPU. */
+            ESP_LOGD(TAG, "Async memcpy failed, copying with CPU.");
+            hagl_hal_dma_wait_all();
+            for (; y < src->height; y++) {
+                memcpy(dst, from, line);
+                dst += bitmap->pitch;
+                from += src->pitch;
+            }
+            return true;
+        }
+        dst += bitmap->pitch;
+        from += src->pitch;
+    }
+
+    return true;
+}
+
+void
+hagl_hal_dma_wait_all(void)
+{
+    dma_wait(submitted);
+    hagl_hal_dma_pending = (hagl_window_t) {
+        .x0 = UINT16_MAX, .y0 = UINT16_MAX, .x1 = 0, .y1 = 0
+    };
+}
+
+void
+hagl_hal_blit_wait(hagl_backend_t *backend)
+{
+    (void) backend;
+    hagl_hal_dma_wait_all();
+}
+
+void
+hagl_hal_dma_init(void)
+{
+    async_memcpy_config_t config = ASYNC_MEMCPY_DEFAULT_CONFIG();
+
+    config.backlog = DMA_BACKLOG;
+    done = xSemaphoreCreateBinary();
+
+    if (ESP_OK != esp_async_memcpy_install(&config, &dma)) {
+        ESP_LOGE(TAG, "Failed to install async memcpy, blitting with CPU.");
+        dma = NULL;
+    }
+}
+
+#endif /* CONFIG_HAGL_HAL_DMA_BLIT */
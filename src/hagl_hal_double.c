@@ -49,126 +49,451 @@ valid.
 #include <esp_log.h>
 #include <esp_heap_caps.h>
 #include <string.h>
+#include <stdbool.h>
 #include <mipi_display.h>
 #include <hagl/bitmap.h>
 #include <hagl.h>
 
+#include "hagl_hal_pixel.h"
+
 #ifdef CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING
 #ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-static SemaphoreHandle_t mutex;
+#include <freertos/task.h>
+#include <stdatomic.h>
+
+#define SNAPSHOT_LINES  (CONFIG_HAGL_HAL_SNAPSHOT_LINES)
+#define SNAPSHOT_RETRIES    (4)
+
+/* Drawing operations in progress and finished. */
+static atomic_uint drawing;
+static atomic_uint generation;
+
+/* Drawing blocks only while flush holds the back buffer. */
+static atomic_bool holding;
+static SemaphoreHandle_t hold;
+static bool held = false;
+
+/* Consistent copies of the back buffer are sent from these. */
+static uint8_t *bands[2];
+static uint32_t fences[2];
+static uint8_t current = 0;
 #endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
 // static uint8_t *buffer;
 
 static hagl_bitmap_t bb;
 
-static spi_device_handle_t spi;
+static mipi_display_t display;
 static const char *TAG = "hagl_esp_mipi";
 
-static size_t
-flush(void *self)
+static inline int
+min(int a, int b)
 {
+    return (a > b) ? b : a;
+}
+
+#ifdef CONFIG_HAGL_HAL_DIRTY_RECTANGLES
+static inline int
+max(int a, int b)
+{
+    return (a > b) ? a : b;
+}
+
+static hagl_window_t dirty[CONFIG_HAGL_HAL_DIRTY_RECTANGLES_MAX];
+static uint8_t dirty_count = 0;
+/* Initially the whole back buffer is unknown to the display. */
+static bool dirty_full = true;
 #ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
+/* Protects the dirty areas when drawing from several tasks. */
+static portMUX_TYPE spinlock = portMUX_INITIALIZER_UNLOCKED;
+#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
+
+static void
+dirty_add(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    if (dirty_full) {
+        return;
+    }
+
+    /* Scaled blits are not clipped, keep the area inside the back buffer. */
+    if (x0 >= bb.width || y0 >= bb.height) {
+        return;
+    }
+    x1 = min(x1, bb.width - 1);
+    y1 = min(y1, bb.height - 1);
+
+    /* Already inside a known dirty area, nothing to do. */
+    for (uint8_t i = 0; i < dirty_count; i++) {
+        if (x0 >= dirty[i].x0 && x1 <= dirty[i].x1 && y0 >= dirty[i].y0 && y1 <= dirty[i].y1) {
+            return;
+        }
+    }
+
+    /* Merge with all overlapping or touching areas. */
+    uint8_t i = 0;
+    while (i < dirty_count) {
+        if (x0 <= dirty[i].x1 + 1 && dirty[i].x0 <= x1 + 1 &&
+            y0 <= dirty[i].y1 + 1 && dirty[i].y0 <= y1 + 1) {
+            x0 = min(x0, dirty[i].x0);
+            y0 = min(y0, dirty[i].y0);
+            x1 = max(x1, dirty[i].x1);
+            y1 = max(y1, dirty[i].y1);
+
+            /* Remove the merged area and start over with the grown one. */
+            dirty[i] = dirty[--dirty_count];
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+
+    /* Too many separate areas, fall back to flushing everything. */
+    if (CONFIG_HAGL_HAL_DIRTY_RECTANGLES_MAX == dirty_count) {
+        dirty_full = true;
+        return;
+    }
+
+    dirty[dirty_count].x0 = x0;
+    dirty[dirty_count].y0 = y0;
+    dirty[dirty_count].x1 = x1;
+    dirty[dirty_count].y1 = y1;
+    dirty_count++;
+}
+#else
+#define dirty_add(x0, y0, x1, y1)
+#endif /* CONFIG_HAGL_HAL_DIRTY_RECTANGLES */
+
+#ifdef CONFIG_HAGL_HAL_ROW_HASH
+/* Hash of each row last sent to the display. */
+static uint32_t hashes[DISPLAY_HEIGHT];
+static bool hashed = false;
+#endif /* CONFIG_HAGL_HAL_ROW_HASH */
+
+#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
+static inline void
+draw_begin(void)
+{
+    while (1) {
+        atomic_fetch_add(&drawing, 1);
+        if (!atomic_load(&holding)) {
+            return;
+        }
+        /* Flush is holding the back buffer, wait until it is done. */
+        atomic_fetch_sub(&drawing, 1);
+        xSemaphoreTake(hold, portMAX_DELAY);
+        xSemaphoreGive(hold);
+    }
+}
+
+static inline void
+draw_end(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+#ifdef CONFIG_HAGL_HAL_DIRTY_RECTANGLES
+    portENTER_CRITICAL(&spinlock);
+    dirty_add(x0, y0, x1, y1);
+    portEXIT_CRITICAL(&spinlock);
+#else
+    (void) x0;
+    (void) y0;
+    (void) x1;
+    (void) y1;
+#endif /* CONFIG_HAGL_HAL_DIRTY_RECTANGLES */
+    atomic_fetch_add(&generation, 1);
+    atomic_fetch_sub(&drawing, 1);
+}
+
+/* Makes new drawing operations wait and lets the ones in progress finish. */
+static void
+hold_begin(void)
+{
+    xSemaphoreTake(hold, portMAX_DELAY);
+    atomic_store(&holding, true);
+    while (atomic_load(&drawing)) {
+        vTaskDelay(1);
+    }
+    held = true;
+}
+
+static void
+hold_end(void)
+{
+    if (held) {
+        held = false;
+        atomic_store(&holding, false);
+        xSemaphoreGive(hold);
+    }
+}
+
+/*
+ * Copies rows of the back buffer while no drawing operation is in
+ * progress. If something was drawn during the copy it is done again.
+ * Each band is consistent on its own. If drawing keeps changing the
+ * band the back buffer is held until the end of the flush, so that
+ * the flush cannot starve and the remaining bands are from the same
+ * frame.
+ */
+static void
+snapshot(uint8_t *band, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h)
+{
+    const size_t line = w * DISPLAY_DEPTH / 8;
+    const uint8_t *src = bb.buffer + y0 * bb.pitch + x0 * DISPLAY_DEPTH / 8;
+    uint8_t retries = 0;
+
+    while (!held) {
+        const unsigned int before = atomic_load(&generation);
+
+        if (0 == atomic_load(&drawing)) {
+            for (uint16_t y = 0; y < h; y++) {
+                memcpy(band + y * line, src + y * bb.pitch, line);
+            }
+            /* Copy must not be reordered after the checks. */
+            atomic_thread_fence(memory_order_acquire);
+            if (0 == atomic_load(&drawing) && before == atomic_load(&generation)) {
+                return;
+            }
+        }
+
+        if (++retries > SNAPSHOT_RETRIES) {
+            hold_begin();
+        }
+    }
+
+    for (uint16_t y = 0; y < h; y++) {
+        memcpy(band + y * line, src + y * bb.pitch, line);
+    }
+}
+
+/*
+ * Sends the window one band at a time. Next band is copied while the
+ * previous one is being sent.
+ */
+static size_t
+flush_window(uint16_t x0, uint16_t y0, uint16_t w, uint16_t h)
+{
     size_t size = 0;
-    /* Flush the whole back buffer with locking. */
-    xSemaphoreTake(mutex, portMAX_DELAY);
-    size = mipi_display_write(spi, 0, 0, bb.width, bb.height, (uint8_t *) bb.buffer);
-    xSemaphoreGive(mutex);
+
+    for (uint16_t y = y0; y < y0 + h; y += SNAPSHOT_LINES) {
+        const uint16_t rows = min(SNAPSHOT_LINES, y0 + h - y);
+
+        mipi_display_fence_wait(&display, fences[current]);
+        snapshot(bands[current], x0, y, w, rows);
+#ifdef CONFIG_HAGL_HAL_ROW_HASH
+        size += mipi_display_write_changed(&display, y, rows, bands[current], hashes, !hashed);
+#else
+        fences[current] = mipi_display_write_async(&display, x0, y, w, rows, bands[current]);
+        size += BITMAP_SIZE(w, rows, DISPLAY_DEPTH);
+#endif /* CONFIG_HAGL_HAL_ROW_HASH */
+        current ^= 1;
+    }
+
     return size;
+}
 #else
-    /* Flush the whole back buffer. */
-    return mipi_display_write(spi, 0, 0, bb.width, bb.height, (uint8_t *) bb.buffer);
-#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
+#define draw_begin()
+#define draw_end(x0, y0, x1, y1) dirty_add(x0, y0, x1, y1)
+
+static size_t
+flush_window(uint16_t x0, uint16_t y0, uint16_t w, uint16_t h)
+{
+#ifdef CONFIG_HAGL_HAL_ROW_HASH
+    /* Flush only the rows which changed since last flush. */
+    (void) x0;
+    (void) w;
+    return mipi_display_write_changed(&display, y0, h, bb.buffer + y0 * bb.pitch, hashes, !hashed);
+#else
+    return mipi_display_write_region(
+        &display, x0, y0, w, h, bb.pitch,
+        (uint8_t *) bb.buffer + bb.pitch * y0 + x0 * (DISPLAY_DEPTH / 8)
+    );
+#endif /* CONFIG_HAGL_HAL_ROW_HASH */
 }
+#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
 
-static void
-put_pixel(void *self, int16_t x0, int16_t y0, hagl_color_t color)
+#ifdef CONFIG_HAGL_HAL_DIRTY_RECTANGLES
+static size_t
+flush_dirty(void)
 {
+    hagl_window_t windows[CONFIG_HAGL_HAL_DIRTY_RECTANGLES_MAX];
+    uint8_t count;
+    bool full;
+    size_t size = 0;
+
+    /* Take a copy so drawing during the transfer is flushed next time. */
 #ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-    xSemaphoreTake(mutex, portMAX_DELAY);
+    portENTER_CRITICAL(&spinlock);
 #endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
-    bb.put_pixel(&bb, x0, y0, color);
+    count = dirty_count;
+    full = dirty_full;
+    memcpy(windows, dirty, count * sizeof(hagl_window_t));
+    dirty_count = 0;
+    dirty_full = false;
 #ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-    xSemaphoreGive(mutex);
+    portEXIT_CRITICAL(&spinlock);
 #endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
+
+    if (full) {
+        return flush_window(0, 0, bb.width, bb.height);
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        size += flush_window(
+            windows[i].x0,
+            windows[i].y0,
+            windows[i].x1 - windows[i].x0 + 1,
+            windows[i].y1 - windows[i].y0 + 1
+        );
+    }
+
+    return size;
+}
+#endif /* CONFIG_HAGL_HAL_DIRTY_RECTANGLES */
+
+static size_t
+flush(void *self)
+{
+    size_t size;
+
+    /* Blits still being copied must be in the back buffer before sending. */
+    hagl_hal_dma_wait_all();
+
+    /* Does nothing unless tearing effect sync is enabled. */
+    mipi_display_vsync_wait(&display);
+
+#if defined(CONFIG_HAGL_HAL_DIRTY_RECTANGLES)
+    /* Flush only the changed areas of the back buffer. */
+    size = flush_dirty();
+#else
+    /* Flush the whole back buffer. */
+    size = flush_window(0, 0, bb.width, bb.height);
+#endif /* CONFIG_HAGL_HAL_DIRTY_RECTANGLES */
+
+#ifdef CONFIG_HAGL_HAL_ROW_HASH
+    hashed = true;
+#endif /* CONFIG_HAGL_HAL_ROW_HASH */
+
+#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
+    /* Back buffer was copied already, wait only for the last bands. */
+    hold_end();
+    mipi_display_fence_wait(&display, fences[0]);
+    mipi_display_fence_wait(&display, fences[1]);
+#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
+
+    return size;
+}
+
+static void
+put_pixel(void *self, int16_t x0, int16_t y0, hagl_color_t color)
+{
+    draw_begin();
+    hagl_hal_put_pixel(&bb, x0, y0, color);
+    draw_end(x0, y0, x0, y0);
 }
 
 static hagl_color_t
 get_pixel(void *self, int16_t x0, int16_t y0)
 {
-    return bb.get_pixel(&bb, x0, y0);
+    return hagl_hal_get_pixel(&bb, x0, y0);
 }
 
 static void
 blit(void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
 {
-#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-    xSemaphoreTake(mutex, portMAX_DELAY);
-#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
-    bb.blit(&bb, x0, y0, src);
-#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-    xSemaphoreGive(mutex);
-#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
+    draw_begin();
+    hagl_hal_blit(&bb, x0, y0, src);
+    draw_end(x0, y0, x0 + src->width - 1, y0 + src->height - 1);
 }
 
 static void
 scale_blit(void *self, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
 {
-#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-    xSemaphoreTake(mutex, portMAX_DELAY);
-#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
-    bb.scale_blit(&bb, x0, y0, w, h, src);
-#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-    xSemaphoreGive(mutex);
-#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
+    draw_begin();
+    hagl_hal_dma_wait(x0, y0, x0 + w - 1, y0 + h - 1);
+    hagl_hal_scale_blit(&bb, x0, y0, w, h, src);
+    draw_end(x0, y0, x0 + w - 1, y0 + h - 1);
 }
 
 static void
 hline(void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
 {
-#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-    xSemaphoreTake(mutex, portMAX_DELAY);
-#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
-    bb.hline(&bb, x0, y0, width, color);
-#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-    xSemaphoreGive(mutex);
-#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
+    draw_begin();
+    hagl_hal_dma_wait(x0, y0, x0 + width - 1, y0);
+    hagl_hal_fill_bitmap(&bb, x0, y0, width, 1, color);
+    draw_end(x0, y0, x0 + width - 1, y0);
 }
 
 static void
 vline(void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
 {
-#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-    xSemaphoreTake(mutex, portMAX_DELAY);
-#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
-    bb.vline(&bb, x0, y0, height, color);
-#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-    xSemaphoreGive(mutex);
-#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
+    draw_begin();
+    hagl_hal_vline(&bb, x0, y0, height, color);
+    draw_end(x0, y0, x0, y0 + height - 1);
+}
+
+void
+hagl_hal_fill_rect(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_color_t color)
+{
+    if (!hagl_hal_clip_rect(&backend->clip, &x0, &y0, &w, &h)) {
+        return;
+    }
+    draw_begin();
+    hagl_hal_dma_wait(x0, y0, x0 + w - 1, y0 + h - 1);
+    hagl_hal_fill_bitmap(&bb, x0, y0, w, h, color);
+    draw_end(x0, y0, x0 + w - 1, y0 + h - 1);
+}
+
+#ifdef CONFIG_HAGL_HAL_DMA_BLIT
+void
+hagl_hal_blit_async(hagl_backend_t *backend, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+{
+    const hagl_window_t *clip = &backend->clip;
+
+    /* HAGL clips partially visible bitmaps pixel by pixel. */
+    if (x0 < clip->x0 || y0 < clip->y0 || x0 + src->width - 1 > clip->x1 || y0 + src->height - 1 > clip->y1) {
+        hagl_blit(backend, x0, y0, src);
+        return;
+    }
+    draw_begin();
+    if (!hagl_hal_dma_blit(&bb, x0, y0, src)) {
+        hagl_hal_blit_cpu(&bb, x0, y0, src);
+    }
+    draw_end(x0, y0, x0 + src->width - 1, y0 + src->height - 1);
+}
+#endif /* CONFIG_HAGL_HAL_DMA_BLIT */
+
+mipi_display_t *
+hagl_hal_get_display(hagl_backend_t *backend)
+{
+    (void) backend;
+    return &display;
 }
 
-// void hagl_hal_clear_screen()
-// {
-// #ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-//     xSemaphoreTake(mutex, portMAX_DELAY);
-// #endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
-//     hagl_color_t *ptr = (hagl_color_t *) buffer;
-//     size_t count = DISPLAY_WIDTH * DISPLAY_HEIGHT;
+void
+hagl_hal_standby(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, bool idle)
+{
+    const hagl_window_t screen = {0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1};
+
+    if (hagl_hal_clip_rect(&screen, &x0, &y0, &w, &h)) {
+        mipi_display_enter_partial(&display, x0, y0, x0 + w - 1, y0 + h - 1, idle);
+        hagl_set_clip(backend, x0, y0, x0 + w - 1, y0 + h - 1);
+    }
+}
 
-//     while (--count) {
-//         *ptr++ = 0x0000;
-//     }
-// #ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-//     xSemaphoreGive(mutex);
-// #endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
-// }
+void
+hagl_hal_wake(hagl_backend_t *backend)
+{
+    mipi_display_exit_partial(&display);
+    hagl_set_clip(backend, 0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1);
+
+    /* Rows outside of the partial area were not sent, flush them too. */
+    draw_begin();
+    draw_end(0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1);
+}
 
 void
 hagl_hal_init(hagl_backend_t *backend)
 {
-    mipi_display_init(&spi);
-#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
-    mutex = xSemaphoreCreateMutex();
-#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
+    const mipi_display_config_t config = MIPI_DISPLAY_CONFIG_DEFAULT();
+
+    mipi_display_init(&display, &config);
 
     ESP_LOGI(
         TAG, "Largest (MALLOC_CAP_DMA | MALLOC_CAP_32BIT) block before init: %d",
@@ -177,12 +502,27 @@ hagl_hal_init(hagl_backend_t *backend)
 
     backend->buffer = (uint8_t *) heap_caps_malloc(
             BITMAP_SIZE(DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_DEPTH),
-            MALLOC_CAP_DMA
+            HAGL_HAL_BACK_BUFFER_CAPS
         );
     if (NULL == backend->buffer) {
         ESP_LOGE(TAG, "NO BUFFER");
     };
 
+#ifdef CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING
+    hold = xSemaphoreCreateMutex();
+
+    /* Bands are sent with DMA so they must be in internal memory. */
+    for (uint8_t i = 0; i < 2; i++) {
+        bands[i] = (uint8_t *) heap_caps_malloc(
+            BITMAP_SIZE(DISPLAY_WIDTH, SNAPSHOT_LINES, DISPLAY_DEPTH),
+            MALLOC_CAP_DMA | MALLOC_CAP_32BIT
+        );
+        if (NULL == bands[i]) {
+            ESP_LOGE(TAG, "Failed to alloc snapshot band %d.", i);
+        }
+    }
+#endif /* CONFIG_HAGL_HAL_LOCK_WHEN_FLUSHING */
+
     ESP_LOGI(
         TAG, "Largest (MALLOC_CAP_DMA | MALLOC_CAP_32BIT) block after init: %d",
         heap_caps_get_largest_free_block(MALLOC_CAP_DMA | MALLOC_CAP_32BIT)
@@ -202,6 +542,7 @@ hagl_hal_init(hagl_backend_t *backend)
     backend->flush = flush;
 
     hagl_bitmap_init(&bb, backend->width, backend->height, backend->depth, backend->buffer);
+    hagl_hal_dma_init();
 }
 
 #endif /* CONFIG_HAGL_HAL_USE_DOUBLE_BUFFERING */
@@ -0,0 +1,147 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Helpers for filling rectangles shared by all HALs. Back buffers are filled
+with word wide stores, one row is filled and then copied to the rest of
+the rows.
+
+*/
+
+#include "sdkconfig.h"
+#include "hagl_hal.h"
+
+#include <string.h>
+#include <stdbool.h>
+#include <hagl/bitmap.h>
+
+bool
+hagl_hal_clip_rect(const hagl_window_t *clip, int16_t *x0, int16_t *y0, uint16_t *w, uint16_t *h)
+{
+    /* Wide enough for any int16_t origin plus uint16_t size. */
+    int32_t x1 = (int32_t) *x0 + *w - 1;
+    int32_t y1 = (int32_t) *y0 + *h - 1;
+
+    if (0 == *w || 0 == *h) {
+        return false;
+    }
+
+    if (x1 < clip->x0 || *x0 > clip->x1 || y1 < clip->y0 || *y0 > clip->y1) {
+        return false;
+    }
+
+    if (*x0 < clip->x0) {
+        *x0 = clip->x0;
+    }
+    if (*y0 < clip->y0) {
+        *y0 = clip->y0;
+    }
+    if (x1 > clip->x1) {
+        x1 = clip->x1;
+    }
+    if (y1 > clip->y1) {
+        y1 = clip->y1;
+    }
+
+    *w = x1 - *x0 + 1;
+    *h = y1 - *y0 + 1;
+
+    return true;
+}
+
+static void
+fill_span(uint8_t *ptr, uint16_t count, uint8_t bytes, hagl_color_t color)
+{
+    if (0 == count) {
+        return;
+    }
+
+    if (2 == bytes) {
+        /* Align to word boundary, then store two pixels at a time. */
+        if ((uintptr_t) ptr & 2) {
+            *(uint16_t *) ptr = color;
+            ptr += 2;
+            count--;
+        }
+
+        uint32_t *word = (uint32_t *) ptr;
+        const uint32_t pair = (uint32_t) color << 16 | (uint16_t) color;
+
+        for (; count >= 2; count -= 2) {
+            *(word++) = pair;
+        }
+
+        if (count) {
+            *(uint16_t *) word = color;
+        }
+        return;
+    }
+
+    /* Write first pixel and double the filled part until done. */
+    const size_t size = count * bytes;
+    size_t filled = bytes;
+
+    memcpy(ptr, &color, bytes);
+    while (filled < size) {
+        size_t chunk = (filled < size - filled) ? filled : size - filled;
+        memcpy(ptr + filled, ptr, chunk);
+        filled += chunk;
+    }
+}
+
+void
+hagl_hal_fill_bitmap(hagl_bitmap_t *bitmap, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_color_t color)
+{
+    const size_t line = w * bitmap->depth / 8;
+    uint8_t *first = bitmap->buffer + y0 * bitmap->pitch + x0 * bitmap->depth / 8;
+    uint8_t *ptr = first + bitmap->pitch;
+
+    if (0 == w || 0 == h) {
+        return;
+    }
+
+    fill_span(first, w, bitmap->depth / 8, color);
+    for (uint16_t y = 1; y < h; y++) {
+        memcpy(ptr, first, line);
+        ptr += bitmap->pitch;
+    }
+}
+
+void
+hagl_hal_clear(hagl_backend_t *backend)
+{
+    const hagl_window_t clip = backend->clip;
+
+    hagl_hal_fill_rect(
+        backend, clip.x0, clip.y0, clip.x1 - clip.x0 + 1, clip.y1 - clip.y0 + 1, 0
+    );
+}
@@ -0,0 +1,375 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+This is the HAL used when indexed buffering is enabled. The back buffer
+holds 8 bit palette indices instead of display colors which halves the
+memory needed with 16 bit pixel format. When flushing the indices are
+expanded through the palette into two small bounce buffers of few lines.
+While one bounce buffer is being sent the next one is being expanded.
+
+Optionally two index buffers are allocated. Then like in triple buffering
+a separate flush task sends the finished frame to the display while
+drawing continues to the other one.
+
+Note that all coordinates are already clipped in the main library itself.
+HAL does not need to validate the coordinates, they can alway be assumed
+valid.
+
+*/
+
+#include "sdkconfig.h"
+#include "hagl_hal.h"
+
+#ifdef CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <string.h>
+#include <mipi_display.h>
+#include <hagl/bitmap.h>
+#include <hagl.h>
+
+#define BOUNCE_LINES    (CONFIG_HAGL_HAL_INDEXED_BOUNCE_LINES)
+
+static uint8_t *buffer1;
+static uint8_t *buffer2;
+static hagl_hal_pixel_t *bounce[2];
+static uint32_t fences[2];
+static hagl_hal_pixel_t palette[256];
+
+static hagl_bitmap_t bb;
+
+static mipi_display_t display;
+static const char *TAG = "hagl_esp_mipi";
+
+#ifdef CONFIG_HAGL_HAL_INDEXED_TWO_BUFFERS
+static QueueHandle_t mailbox;
+static SemaphoreHandle_t idle;
+static volatile uint32_t presented = 0;
+static volatile uint32_t dropped = 0;
+#endif /* CONFIG_HAGL_HAL_INDEXED_TWO_BUFFERS */
+
+static size_t
+send(const uint8_t *buffer)
+{
+    uint16_t first, last;
+    uint8_t current = 0;
+
+    mipi_display_vsync_wait(&display);
+
+    /* Only rows shown in partial mode are expanded and sent. */
+    mipi_display_get_partial(&display, &first, &last);
+
+    for (uint16_t y0 = first; y0 <= last; y0 += BOUNCE_LINES) {
+        uint16_t height = last - y0 + 1;
+        if (height > BOUNCE_LINES) {
+            height = BOUNCE_LINES;
+        }
+
+        const uint8_t *src = buffer + y0 * DISPLAY_WIDTH;
+        hagl_hal_pixel_t *dst = bounce[current];
+        size_t count = height * DISPLAY_WIDTH;
+
+        /* Wait until the bounce buffer is not being sent anymore. */
+        mipi_display_fence_wait(&display, fences[current]);
+
+        while (count--) {
+            *(dst++) = palette[*(src++)];
+        }
+
+        fences[current] = mipi_display_write_async(
+            &display, 0, y0, DISPLAY_WIDTH, height, (uint8_t *) bounce[current]
+        );
+        current ^= 1;
+    }
+
+    mipi_display_fence_wait(&display, fences[0]);
+    mipi_display_fence_wait(&display, fences[1]);
+
+    return BITMAP_SIZE(DISPLAY_WIDTH, (last - first + 1), DISPLAY_DEPTH);
+}
+
+#ifdef CONFIG_HAGL_HAL_INDEXED_TWO_BUFFERS
+static void
+flush_task(void *params)
+{
+    uint8_t *buffer;
+
+    (void) params;
+
+    while (1) {
+        xQueueReceive(mailbox, &buffer, portMAX_DELAY);
+        send(buffer);
+
+        presented++;
+        xSemaphoreGive(idle);
+    }
+}
+
+static size_t
+flush(void *self)
+{
+    /*
+     * Flush task is still sending the other buffer. Keep drawing to the
+     * current one, the newest frame is presented on next flush.
+     */
+    if (pdFALSE == xSemaphoreTake(idle, 0)) {
+        dropped++;
+        return 0;
+    }
+
+    uint8_t *buffer = bb.buffer;
+    if (bb.buffer == buffer1) {
+        bb.buffer = buffer2;
+    } else {
+        bb.buffer = buffer1;
+    }
+
+    /* Hand the finished buffer to the flush task. */
+    xQueueOverwrite(mailbox, &buffer);
+    return BITMAP_SIZE(DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_DEPTH);
+}
+
+void
+hagl_hal_get_frame_stats(hagl_hal_frame_stats_t *stats)
+{
+    stats->presented = presented;
+    stats->dropped = dropped;
+}
+
+void
+hagl_hal_reset_frame_stats(void)
+{
+    presented = 0;
+    dropped = 0;
+}
+#else
+static size_t
+flush(void *self)
+{
+    return send(bb.buffer);
+}
+#endif /* CONFIG_HAGL_HAL_INDEXED_TWO_BUFFERS */
+
+void
+hagl_hal_set_palette(uint8_t first, uint16_t count, const hagl_hal_pixel_t *colors)
+{
+    if (first + count > 256) {
+        count = 256 - first;
+    }
+    memcpy(&palette[first], colors, count * sizeof(hagl_hal_pixel_t));
+}
+
+static void
+put_pixel(void *self, int16_t x0, int16_t y0, hagl_color_t color)
+{
+    bb.put_pixel(&bb, x0, y0, color);
+}
+
+static hagl_color_t
+get_pixel(void *self, int16_t x0, int16_t y0)
+{
+    return bb.get_pixel(&bb, x0, y0);
+}
+
+static void
+blit(void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+{
+    bb.blit(&bb, x0, y0, src);
+}
+
+static void
+scale_blit(void *self, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
+{
+    bb.scale_blit(&bb, x0, y0, w, h, src);
+}
+
+static void
+hline(void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
+{
+    memset(bb.buffer + y0 * bb.pitch + x0, color, width);
+}
+
+static void
+vline(void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
+{
+    bb.vline(&bb, x0, y0, height, color);
+}
+
+void
+hagl_hal_fill_rect(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_color_t color)
+{
+    if (hagl_hal_clip_rect(&backend->clip, &x0, &y0, &w, &h)) {
+        hagl_hal_fill_bitmap(&bb, x0, y0, w, h, color);
+    }
+}
+
+#if 16 == DISPLAY_DEPTH
+/* Default palette is RGB332 converted to byte swapped RGB565. */
+static void
+default_palette(void)
+{
+    for (uint16_t i = 0; i < 256; i++) {
+        uint16_t r = (i >> 5) * 31 / 7;
+        uint16_t g = ((i >> 2) & 0x07) * 63 / 7;
+        uint16_t b = (i & 0x03) * 31 / 3;
+        uint16_t rgb = (r << 11) | (g << 5) | b;
+
+        palette[i] = (rgb >> 8) | (rgb << 8);
+    }
+}
+#elif 8 == DISPLAY_DEPTH
+/* Display is RGB332 already. */
+static void
+default_palette(void)
+{
+    for (uint16_t i = 0; i < 256; i++) {
+        palette[i] = i;
+    }
+}
+#else
+/* Expanded pixels must fill hagl_hal_pixel_t exactly. */
+#error "Indexed buffering supports only 16 and 8 bit pixel formats."
+#endif /* 16 == DISPLAY_DEPTH */
+
+static uint8_t *
+alloc_buffer(const char *name)
+{
+    uint8_t *buffer = (uint8_t *) heap_caps_malloc(
+            BITMAP_SIZE(DISPLAY_WIDTH, DISPLAY_HEIGHT, 8),
+            MALLOC_CAP_32BIT
+        );
+
+    if (NULL == buffer) {
+        ESP_LOGE(TAG, "Failed to alloc %s.", name);
+    } else {
+        ESP_LOGI(TAG, "%s at: %p", name, buffer);
+        memset(buffer, 0x00, BITMAP_SIZE(DISPLAY_WIDTH, DISPLAY_HEIGHT, 8));
+    };
+
+    return buffer;
+}
+
+mipi_display_t *
+hagl_hal_get_display(hagl_backend_t *backend)
+{
+    (void) backend;
+    return &display;
+}
+
+void
+hagl_hal_standby(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, bool idle)
+{
+    const hagl_window_t screen = {0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1};
+
+    if (hagl_hal_clip_rect(&screen, &x0, &y0, &w, &h)) {
+        mipi_display_enter_partial(&display, x0, y0, x0 + w - 1, y0 + h - 1, idle);
+        hagl_set_clip(backend, x0, y0, x0 + w - 1, y0 + h - 1);
+    }
+}
+
+void
+hagl_hal_wake(hagl_backend_t *backend)
+{
+    mipi_display_exit_partial(&display);
+    hagl_set_clip(backend, 0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1);
+}
+
+void
+hagl_hal_init(hagl_backend_t *backend)
+{
+    const mipi_display_config_t config = MIPI_DISPLAY_CONFIG_DEFAULT();
+
+    mipi_display_init(&display, &config);
+
+    ESP_LOGI(TAG, "Indexed buffering mode");
+
+    /* Only the bounce buffers are sent with DMA. */
+    for (uint8_t i = 0; i < 2; i++) {
+        bounce[i] = (hagl_hal_pixel_t *) heap_caps_malloc(
+                BITMAP_SIZE(DISPLAY_WIDTH, BOUNCE_LINES, DISPLAY_DEPTH),
+                MALLOC_CAP_DMA | MALLOC_CAP_32BIT
+            );
+        if (NULL == bounce[i]) {
+            ESP_LOGE(TAG, "Failed to alloc bounce buffer %d.", i + 1);
+        }
+        fences[i] = 0;
+    }
+
+    buffer1 = alloc_buffer("Buffer 1");
+#ifdef CONFIG_HAGL_HAL_INDEXED_TWO_BUFFERS
+    buffer2 = alloc_buffer("Buffer 2");
+#else
+    buffer2 = NULL;
+#endif /* CONFIG_HAGL_HAL_INDEXED_TWO_BUFFERS */
+
+    default_palette();
+
+    backend->buffer = buffer1;
+    backend->width = MIPI_DISPLAY_WIDTH;
+    backend->height = MIPI_DISPLAY_HEIGHT;
+    backend->depth = 8;
+    backend->put_pixel = put_pixel;
+    backend->get_pixel = get_pixel;
+    backend->hline = hline;
+    backend->vline = vline;
+    backend->blit = blit;
+    backend->scale_blit = scale_blit;
+    backend->flush = flush;
+
+    hagl_bitmap_init(&bb, backend->width, backend->height, backend->depth, backend->buffer);
+
+#ifdef CONFIG_HAGL_HAL_INDEXED_TWO_BUFFERS
+    mailbox = xQueueCreate(1, sizeof(uint8_t *));
+    idle = xSemaphoreCreateBinary();
+    xSemaphoreGive(idle);
+
+#if CONFIG_HAGL_HAL_FLUSH_TASK_CORE < 0
+    xTaskCreate(
+        flush_task, "flush_task", CONFIG_HAGL_HAL_FLUSH_TASK_STACK_SIZE, NULL,
+        CONFIG_HAGL_HAL_FLUSH_TASK_PRIORITY, NULL
+    );
+#else
+    xTaskCreatePinnedToCore(
+        flush_task, "flush_task", CONFIG_HAGL_HAL_FLUSH_TASK_STACK_SIZE, NULL,
+        CONFIG_HAGL_HAL_FLUSH_TASK_PRIORITY, NULL, CONFIG_HAGL_HAL_FLUSH_TASK_CORE
+    );
+#endif /* CONFIG_HAGL_HAL_FLUSH_TASK_CORE < 0 */
+#endif /* CONFIG_HAGL_HAL_INDEXED_TWO_BUFFERS */
+}
+
+#endif /* CONFIG_HAGL_HAL_USE_INDEXED_BUFFERING */
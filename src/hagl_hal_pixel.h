@@ -0,0 +1,195 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Pixel access to back buffers specialized for the configured depth. With
+8 and 16 bit pixels these compile to direct stores and loads instead of
+calls through the function pointers of the bitmap. Blits of bitmaps with
+the same depth are copied a row at a time. Other depths use the generic
+bitmap functions.
+
+With CONFIG_HAGL_HAL_DMA_BLIT big blits are copied with DMA instead.
+Accessing pixels inside the area DMA may still be copying to waits for
+the copies to finish first.
+
+Coordinates are assumed to be clipped already, except for scaled blits.
+
+*/
+
+#ifndef _HAGL_HAL_PIXEL_H
+#define _HAGL_HAL_PIXEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <hagl/bitmap.h>
+
+#include "sdkconfig.h"
+#include "hagl_hal.h"
+
+/* Pixel fills its hagl_hal_pixel_t exactly, stores need no masking. */
+#if 16 == DISPLAY_DEPTH || 8 == DISPLAY_DEPTH
+#define HAGL_HAL_NATIVE_PIXEL
+#endif
+
+#ifdef CONFIG_HAGL_HAL_DMA_BLIT
+/* Bounding box of DMA copies in flight, empty when x0 > x1. */
+extern hagl_window_t hagl_hal_dma_pending;
+
+void hagl_hal_dma_init(void);
+bool hagl_hal_dma_blit(hagl_bitmap_t *bitmap, int16_t x0, int16_t y0, hagl_bitmap_t *src);
+void hagl_hal_dma_wait_all(void);
+
+static inline void
+hagl_hal_dma_wait(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    const hagl_window_t *pending = &hagl_hal_dma_pending;
+
+    if (x0 <= pending->x1 && x1 >= pending->x0 && y0 <= pending->y1 && y1 >= pending->y0) {
+        hagl_hal_dma_wait_all();
+    }
+}
+#else
+#define hagl_hal_dma_init()
+#define hagl_hal_dma_blit(bitmap, x0, y0, src) (false)
+#define hagl_hal_dma_wait_all()
+#define hagl_hal_dma_wait(x0, y0, x1, y1)
+#endif /* CONFIG_HAGL_HAL_DMA_BLIT */
+
+#ifdef HAGL_HAL_NATIVE_PIXEL
+static inline hagl_hal_pixel_t *
+hagl_hal_pixel_row(const hagl_bitmap_t *bitmap, int16_t y0)
+{
+    return (hagl_hal_pixel_t *) (bitmap->buffer + y0 * bitmap->pitch);
+}
+#endif /* HAGL_HAL_NATIVE_PIXEL */
+
+static inline void
+hagl_hal_put_pixel(hagl_bitmap_t *bitmap, int16_t x0, int16_t y0, hagl_color_t color)
+{
+    hagl_hal_dma_wait(x0, y0, x0, y0);
+#ifdef HAGL_HAL_NATIVE_PIXEL
+    hagl_hal_pixel_row(bitmap, y0)[x0] = color;
+#else
+    bitmap->put_pixel(bitmap, x0, y0, color);
+#endif /* HAGL_HAL_NATIVE_PIXEL */
+}
+
+static inline hagl_color_t
+hagl_hal_get_pixel(hagl_bitmap_t *bitmap, int16_t x0, int16_t y0)
+{
+    hagl_hal_dma_wait(x0, y0, x0, y0);
+#ifdef HAGL_HAL_NATIVE_PIXEL
+    return hagl_hal_pixel_row(bitmap, y0)[x0];
+#else
+    return bitmap->get_pixel(bitmap, x0, y0);
+#endif /* HAGL_HAL_NATIVE_PIXEL */
+}
+
+static inline void
+hagl_hal_vline(hagl_bitmap_t *bitmap, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
+{
+    hagl_hal_dma_wait(x0, y0, x0, y0 + height - 1);
+#ifdef HAGL_HAL_NATIVE_PIXEL
+    uint8_t *ptr = (uint8_t *) &hagl_hal_pixel_row(bitmap, y0)[x0];
+
+    for (uint16_t y = 0; y < height; y++) {
+        *(hagl_hal_pixel_t *) ptr = color;
+        ptr += bitmap->pitch;
+    }
+#else
+    bitmap->vline(bitmap, x0, y0, height, color);
+#endif /* HAGL_HAL_NATIVE_PIXEL */
+}
+
+/* Same depth is copied a row at a time, others converted. */
+static inline void
+hagl_hal_blit_cpu(hagl_bitmap_t *bitmap, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+{
+    hagl_hal_dma_wait(x0, y0, x0 + src->width - 1, y0 + src->height - 1);
+
+    if (src->depth != bitmap->depth) {
+        bitmap->blit(bitmap, x0, y0, src);
+        return;
+    }
+
+    const size_t line = src->width * src->depth / 8;
+    uint8_t *dst = bitmap->buffer + y0 * bitmap->pitch + x0 * bitmap->depth / 8;
+    const uint8_t *from = src->buffer;
+
+    for (int16_t y = 0; y < src->height; y++) {
+        memcpy(dst, from, line);
+        dst += bitmap->pitch;
+        from += src->pitch;
+    }
+}
+
+/* Big blits are copied with DMA, bitmap is free to change when this returns. */
+static inline void
+hagl_hal_blit(hagl_bitmap_t *bitmap, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+{
+    if (hagl_hal_dma_blit(bitmap, x0, y0, src)) {
+        hagl_hal_dma_wait_all();
+        return;
+    }
+    hagl_hal_blit_cpu(bitmap, x0, y0, src);
+}
+
+/*
+ * HAGL does not clip scaled blits. Parts outside the bitmap are dropped
+ * here, pixel by pixel with the same nearest neighbour mapping.
+ */
+static inline void
+hagl_hal_scale_blit(hagl_bitmap_t *bitmap, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
+{
+    if (x0 + w <= bitmap->width && y0 + h <= bitmap->height) {
+        bitmap->scale_blit(bitmap, x0, y0, w, h, src);
+        return;
+    }
+
+    for (uint16_t y = 0; y < h && y0 + y < bitmap->height; y++) {
+        for (uint16_t x = 0; x < w && x0 + x < bitmap->width; x++) {
+            const hagl_color_t color = src->get_pixel(src, x * src->width / w, y * src->height / h);
+            hagl_hal_put_pixel(bitmap, x0 + x, y0 + y, color);
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _HAGL_HAL_PIXEL_H */
@@ -55,62 +55,213 @@ valid.
 #include <hagl.h>
 
 
-static spi_device_handle_t spi;
+/* Display and pending span of each backend. */
+typedef struct {
+    hagl_backend_t *backend;
+    mipi_display_t *display;
+#ifdef CONFIG_HAGL_HAL_COALESCE_PIXELS
+    hagl_color_t span[DISPLAY_WIDTH];
+    int16_t span_x0;
+    int16_t span_y0;
+    uint16_t span_width;
+#endif /* CONFIG_HAGL_HAL_COALESCE_PIXELS */
+} instance_t;
+
+static mipi_display_t default_display;
+static instance_t instances[CONFIG_HAGL_HAL_MAX_DISPLAYS];
 static const char *TAG = "hagl_esp_mipi";
 
+static instance_t *
+instance(void *self)
+{
+    for (uint8_t i = 1; i < CONFIG_HAGL_HAL_MAX_DISPLAYS; i++) {
+        if (instances[i].backend == self) {
+            return &instances[i];
+        }
+    }
+    return &instances[0];
+}
+
+#ifdef CONFIG_HAGL_HAL_COALESCE_PIXELS
+static size_t
+span_sync(instance_t *hal)
+{
+    size_t size = 0;
+
+    if (hal->span_width) {
+        size = mipi_display_write(
+            hal->display, hal->span_x0, hal->span_y0, hal->span_width, 1, (uint8_t *) hal->span
+        );
+        hal->span_width = 0;
+    }
+    return size;
+}
+
 static void
 put_pixel(void *self, int16_t x0, int16_t y0, hagl_color_t color)
 {
-    mipi_display_write(spi, x0, y0, 1, 1, (uint8_t *) &color);
+    instance_t *hal = instance(self);
+
+    /* Send the span if this pixel does not continue it. */
+    if (hal->span_width && (
+        y0 != hal->span_y0 ||
+        x0 != hal->span_x0 + hal->span_width ||
+        DISPLAY_WIDTH == hal->span_width
+    )) {
+        span_sync(hal);
+    }
+
+    if (0 == hal->span_width) {
+        hal->span_x0 = x0;
+        hal->span_y0 = y0;
+    }
+    hal->span[hal->span_width++] = color;
+}
+
+static size_t
+flush(void *self)
+{
+    return span_sync(instance(self));
 }
+#else
+#define span_sync(hal)
 
+static void
+put_pixel(void *self, int16_t x0, int16_t y0, hagl_color_t color)
+{
+    mipi_display_write(instance(self)->display, x0, y0, 1, 1, (uint8_t *) &color);
+}
+#endif /* CONFIG_HAGL_HAL_COALESCE_PIXELS */
+
+/* Bitmaps in PSRAM or mapped flash are streamed through bounce buffers. */
 static void
 blit(void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
 {
-    mipi_display_write(spi, x0, y0, src->width, src->height, (uint8_t *) src->buffer);
+    instance_t *hal = instance(self);
+
+    span_sync(hal);
+    mipi_display_write(hal->display, x0, y0, src->width, src->height, (uint8_t *) src->buffer);
 }
 
 static void
 hline(void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
 {
-    static hagl_color_t line[DISPLAY_WIDTH];
-    hagl_color_t *ptr = line;
-    uint16_t height = 1;
-
-    for (uint16_t x = 0; x < width; x++) {
-        *(ptr++) = color;
-    }
+    instance_t *hal = instance(self);
 
-    mipi_display_write(spi, x0, y0, width, height, (uint8_t *) line);
+    span_sync(hal);
+    mipi_display_fill(hal->display, x0, y0, width, 1, (uint8_t *) &color);
 }
 
 static void
 vline(void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
 {
-    static hagl_color_t line[DISPLAY_HEIGHT];
-    hagl_color_t *ptr = line;
-    uint16_t width = 1;
+    instance_t *hal = instance(self);
 
-    for (uint16_t x = 0; x < height; x++) {
-        *(ptr++) = color;
+    span_sync(hal);
+    mipi_display_fill(hal->display, x0, y0, 1, height, (uint8_t *) &color);
+}
+
+void
+hagl_hal_fill_rect(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_color_t color)
+{
+    instance_t *hal = instance(backend);
+
+    if (hagl_hal_clip_rect(&backend->clip, &x0, &y0, &w, &h)) {
+        span_sync(hal);
+        mipi_display_fill(hal->display, x0, y0, w, h, (uint8_t *) &color);
     }
+}
 
-    mipi_display_write(spi, x0, y0, width, height, (uint8_t *) line);
+void
+hagl_hal_standby(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, bool idle)
+{
+    const hagl_window_t screen = {0, 0, backend->width - 1, backend->height - 1};
+    instance_t *hal = instance(backend);
+
+    if (hagl_hal_clip_rect(&screen, &x0, &y0, &w, &h)) {
+        span_sync(hal);
+        mipi_display_enter_partial(hal->display, x0, y0, x0 + w - 1, y0 + h - 1, idle);
+        hagl_set_clip(backend, x0, y0, x0 + w - 1, y0 + h - 1);
+    }
 }
 
 void
-hagl_hal_init(hagl_backend_t *backend)
+hagl_hal_wake(hagl_backend_t *backend)
+{
+    mipi_display_exit_partial(instance(backend)->display);
+    hagl_set_clip(backend, 0, 0, backend->width - 1, backend->height - 1);
+}
+
+esp_err_t
+hagl_hal_scroll_area(hagl_backend_t *backend, uint16_t top, uint16_t height)
+{
+    instance_t *hal = instance(backend);
+
+    span_sync(hal);
+    return mipi_display_set_scroll_area(hal->display, top, height);
+}
+
+void
+hagl_hal_scroll(hagl_backend_t *backend, uint16_t offset)
+{
+    instance_t *hal = instance(backend);
+
+    span_sync(hal);
+    mipi_display_set_scroll_offset(hal->display, offset);
+}
+
+mipi_display_t *
+hagl_hal_get_display(hagl_backend_t *backend)
+{
+    return instance(backend)->display;
+}
+
+/*
+ * Binds the backend to an already initialized display. First backend is
+ * the one initialized with hagl_hal_init().
+ */
+void
+hagl_hal_init_display(hagl_backend_t *backend, mipi_display_t *display)
 {
-    mipi_display_init(&spi);
+    instance_t *hal = NULL;
+
+    for (uint8_t i = 0; i < CONFIG_HAGL_HAL_MAX_DISPLAYS; i++) {
+        if (NULL == instances[i].backend || backend == instances[i].backend) {
+            hal = &instances[i];
+            break;
+        }
+    }
+
+    if (NULL == hal) {
+        ESP_LOGE(TAG, "No room for more than %d displays.", CONFIG_HAGL_HAL_MAX_DISPLAYS);
+        return;
+    }
 
-    backend->width = MIPI_DISPLAY_WIDTH;
-    backend->height = MIPI_DISPLAY_HEIGHT;
+    hal->backend = backend;
+    hal->display = display;
+
+    backend->width = display->config.width;
+    backend->height = display->config.height;
     backend->depth = MIPI_DISPLAY_DEPTH;
     backend->put_pixel = put_pixel;
     // backend->get_pixel = get_pixel;
     backend->hline = hline;
     backend->vline = vline;
     backend->blit = blit;
+#ifdef CONFIG_HAGL_HAL_COALESCE_PIXELS
+    backend->flush = flush;
+#endif /* CONFIG_HAGL_HAL_COALESCE_PIXELS */
+
+    hagl_set_clip(backend, 0, 0, backend->width - 1, backend->height - 1);
+}
+
+void
+hagl_hal_init(hagl_backend_t *backend)
+{
+    const mipi_display_config_t config = MIPI_DISPLAY_CONFIG_DEFAULT();
+
+    mipi_display_init(&default_display, &config);
+    hagl_hal_init_display(backend, &default_display);
 }
 
 #endif /* CONFIG_HAGL_HAL_NO_BUFFERING */
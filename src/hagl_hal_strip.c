@@ -0,0 +1,243 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+This is the HAL used when strip buffering is enabled. The GRAM of the
+display driver chip is the framebuffer. The two memory blocks allocated
+by this HAL hold only a few lines of the screen each. Drawing callback
+is called once per strip with the clip window set to the strip. While
+the finished strip is being sent the next one is drawn to the other
+buffer.
+
+Note that all coordinates are already clipped in the main library itself.
+HAL does not need to validate the coordinates, they can alway be assumed
+valid.
+
+*/
+
+#include "sdkconfig.h"
+#include "hagl_hal.h"
+
+#ifdef CONFIG_HAGL_HAL_USE_STRIP_BUFFERING
+
+#include <freertos/FreeRTOS.h>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <string.h>
+#include <stdbool.h>
+#include <mipi_display.h>
+#include <hagl/bitmap.h>
+#include <hagl.h>
+
+#define STRIP_HEIGHT    (CONFIG_HAGL_HAL_STRIP_HEIGHT)
+
+static uint8_t *buffers[2];
+static uint32_t fences[2];
+
+static hagl_bitmap_t strip;
+static int16_t strip_y0 = 0;
+static bool drawing = false;
+
+static mipi_display_t display;
+static const char *TAG = "hagl_esp_mipi";
+
+static size_t
+flush(void *self)
+{
+    /* Strips are sent while rendering, just wait for the last ones. */
+    mipi_display_fence_wait(&display, fences[0]);
+    mipi_display_fence_wait(&display, fences[1]);
+    return 0;
+}
+
+static void
+put_pixel(void *self, int16_t x0, int16_t y0, hagl_color_t color)
+{
+    if (drawing) {
+        strip.put_pixel(&strip, x0, y0 - strip_y0, color);
+    }
+}
+
+static hagl_color_t
+get_pixel(void *self, int16_t x0, int16_t y0)
+{
+    if (drawing) {
+        return strip.get_pixel(&strip, x0, y0 - strip_y0);
+    }
+    return 0;
+}
+
+static void
+blit(void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+{
+    if (drawing) {
+        strip.blit(&strip, x0, y0 - strip_y0, src);
+    }
+}
+
+static void
+hline(void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
+{
+    if (drawing) {
+        hagl_hal_fill_bitmap(&strip, x0, y0 - strip_y0, width, 1, color);
+    }
+}
+
+static void
+vline(void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
+{
+    if (drawing) {
+        strip.vline(&strip, x0, y0 - strip_y0, height, color);
+    }
+}
+
+void
+hagl_hal_fill_rect(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_color_t color)
+{
+    /* Clip window is the current strip while drawing. */
+    if (drawing && hagl_hal_clip_rect(&backend->clip, &x0, &y0, &w, &h)) {
+        hagl_hal_fill_bitmap(&strip, x0, y0 - strip_y0, w, h, color);
+    }
+}
+
+mipi_display_t *
+hagl_hal_get_display(hagl_backend_t *backend)
+{
+    (void) backend;
+    return &display;
+}
+
+void
+hagl_hal_standby(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, bool idle)
+{
+    const hagl_window_t screen = {0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1};
+
+    if (hagl_hal_clip_rect(&screen, &x0, &y0, &w, &h)) {
+        mipi_display_enter_partial(&display, x0, y0, x0 + w - 1, y0 + h - 1, idle);
+        hagl_set_clip(backend, x0, y0, x0 + w - 1, y0 + h - 1);
+    }
+}
+
+void
+hagl_hal_wake(hagl_backend_t *backend)
+{
+    mipi_display_exit_partial(&display);
+    hagl_set_clip(backend, 0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1);
+}
+
+size_t
+hagl_hal_render(hagl_backend_t *backend, hagl_hal_draw_t draw, void *user)
+{
+    const hagl_window_t clip = backend->clip;
+    uint16_t first, last;
+    uint8_t current = 0;
+    size_t size = 0;
+
+    /* Only strips with rows shown in partial mode are rendered. */
+    mipi_display_get_partial(&display, &first, &last);
+    if (first < clip.y0) {
+        first = clip.y0;
+    }
+    if (last > clip.y1) {
+        last = clip.y1;
+    }
+
+    for (int16_t y0 = first - first % STRIP_HEIGHT; y0 <= last; y0 += STRIP_HEIGHT) {
+        int16_t height = DISPLAY_HEIGHT - y0;
+        if (height > STRIP_HEIGHT) {
+            height = STRIP_HEIGHT;
+        }
+
+        /* Wait until the strip buffer is not being sent anymore. */
+        mipi_display_fence_wait(&display, fences[current]);
+
+        strip.buffer = buffers[current];
+        strip_y0 = y0;
+        memset(strip.buffer, 0x00, BITMAP_SIZE(DISPLAY_WIDTH, height, DISPLAY_DEPTH));
+
+        /* Strip is drawn only inside the clip window of the caller. */
+        hagl_set_clip(
+            backend, clip.x0, y0 < first ? first : y0,
+            clip.x1, y0 + height - 1 > last ? last : y0 + height - 1
+        );
+        drawing = true;
+        draw(backend, user);
+        drawing = false;
+
+        fences[current] = mipi_display_write_async(&display, 0, y0, DISPLAY_WIDTH, height, strip.buffer);
+        size += BITMAP_SIZE(DISPLAY_WIDTH, height, DISPLAY_DEPTH);
+
+        current ^= 1;
+    }
+
+    hagl_set_clip(backend, clip.x0, clip.y0, clip.x1, clip.y1);
+
+    return size;
+}
+
+void
+hagl_hal_init(hagl_backend_t *backend)
+{
+    const mipi_display_config_t config = MIPI_DISPLAY_CONFIG_DEFAULT();
+
+    mipi_display_init(&display, &config);
+
+    ESP_LOGI(TAG, "Strip buffering mode, %d lines per strip", STRIP_HEIGHT);
+
+    for (uint8_t i = 0; i < 2; i++) {
+        buffers[i] = (uint8_t *) heap_caps_malloc(
+                BITMAP_SIZE(DISPLAY_WIDTH, STRIP_HEIGHT, DISPLAY_DEPTH),
+                MALLOC_CAP_DMA | MALLOC_CAP_32BIT
+            );
+        if (NULL == buffers[i]) {
+            ESP_LOGE(TAG, "Failed to alloc strip buffer %d.", i + 1);
+        } else {
+            ESP_LOGI(TAG, "Strip buffer %d at: %p", i + 1, buffers[i]);
+        };
+        fences[i] = 0;
+    }
+
+    backend->buffer = buffers[0];
+    backend->width = MIPI_DISPLAY_WIDTH;
+    backend->height = MIPI_DISPLAY_HEIGHT;
+    backend->depth = MIPI_DISPLAY_DEPTH;
+    backend->put_pixel = put_pixel;
+    backend->get_pixel = get_pixel;
+    backend->hline = hline;
+    backend->vline = vline;
+    backend->blit = blit;
+    backend->flush = flush;
+
+    hagl_bitmap_init(&strip, DISPLAY_WIDTH, STRIP_HEIGHT, DISPLAY_DEPTH, buffers[0]);
+}
+
+#endif /* CONFIG_HAGL_HAL_USE_STRIP_BUFFERING */
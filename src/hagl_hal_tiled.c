@@ -0,0 +1,508 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+This is the HAL used when tiled buffering is enabled. The GRAM of the
+display driver chip is the framebuffer. Drawing operations are not
+rasterized immediately. Instead they are recorded to a display list.
+Consecutive pixels of the same color are merged into one operation and
+source bitmaps of blits are copied to the list.
+
+When flushing the operations are binned to screen tiles. Each tile is
+rasterized into one of two small tile buffers and sent to the display
+while the next tile is being rasterized. Memory needed is bounded by the
+display list and two tiles. Tiles with nothing drawn on this or the
+previous frame are skipped. Scene must be redrawn after every flush.
+
+Note that all coordinates are already clipped in the main library itself.
+HAL does not need to validate the coordinates, they can alway be assumed
+valid.
+
+*/
+
+#include "sdkconfig.h"
+#include "hagl_hal.h"
+
+#ifdef CONFIG_HAGL_HAL_USE_TILED_BUFFERING
+
+#include <freertos/FreeRTOS.h>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <mipi_display.h>
+#include <hagl/bitmap.h>
+#include <hagl.h>
+
+#define TILE_WIDTH  (CONFIG_HAGL_HAL_TILE_WIDTH)
+#define TILE_HEIGHT (CONFIG_HAGL_HAL_TILE_HEIGHT)
+#define TILES_X     ((DISPLAY_WIDTH + TILE_WIDTH - 1) / TILE_WIDTH)
+#define TILES_Y     ((DISPLAY_HEIGHT + TILE_HEIGHT - 1) / TILE_HEIGHT)
+#define TILES       (TILES_X * TILES_Y)
+#define LIST_SIZE   (CONFIG_HAGL_HAL_DISPLAY_LIST_SIZE)
+
+typedef enum {
+    OP_FILL,
+    OP_BLIT,
+    OP_SCALE_BLIT,
+} op_type_t;
+
+typedef struct {
+    int16_t x0;
+    int16_t y0;
+    uint16_t w;
+    uint16_t h;
+    union {
+        hagl_color_t color;
+        /* Offset of the copied source bitmap in the list. */
+        uint32_t source;
+    };
+    uint8_t type;
+} op_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t buffer[];
+} source_t;
+
+/* Operations grow from the start of the list, source bitmaps from the end. */
+static uint8_t *list;
+static op_t *ops;
+static uint16_t count = 0;
+static uint32_t top = LIST_SIZE;
+static uint32_t dropped = 0;
+
+/* Range of operations touching each tile. */
+static uint16_t first[TILES];
+static uint16_t last[TILES];
+/* Tiles which had something drawn on the previous frame. */
+static bool shown[TILES];
+
+static uint8_t *buffers[2];
+static uint32_t fences[2];
+static uint8_t current = 0;
+static hagl_bitmap_t tile;
+
+static mipi_display_t display;
+static const char *TAG = "hagl_esp_mipi";
+
+static inline int
+min(int a, int b)
+{
+    return (a > b) ? b : a;
+}
+
+static op_t *
+record(op_type_t type, int16_t x0, int16_t y0, uint16_t w, uint16_t h, size_t extra)
+{
+    extra = (extra + 3) & ~3;
+
+    if ((count + 1) * sizeof(op_t) + extra > top) {
+        dropped++;
+        return NULL;
+    }
+
+    op_t *op = &ops[count++];
+    top -= extra;
+
+    op->x0 = x0;
+    op->y0 = y0;
+    op->w = w;
+    op->h = h;
+    op->type = type;
+    op->source = top;
+
+    return op;
+}
+
+static void
+record_fill(int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_color_t color)
+{
+    op_t *op = record(OP_FILL, x0, y0, w, h, 0);
+
+    if (op) {
+        op->color = color;
+    }
+}
+
+static void
+record_bitmap(op_type_t type, int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
+{
+    /* Source may be gone before flushing, for example a glyph on stack. */
+    const size_t line = src->width * DISPLAY_DEPTH / 8;
+    op_t *op = record(type, x0, y0, w, h, sizeof(source_t) + line * src->height);
+
+    if (NULL == op) {
+        return;
+    }
+
+    source_t *source = (source_t *) (list + op->source);
+    source->width = src->width;
+    source->height = src->height;
+    for (uint16_t y = 0; y < src->height; y++) {
+        memcpy(source->buffer + y * line, src->buffer + y * src->pitch, line);
+    }
+}
+
+static const uint8_t *
+source_pixel(const op_t *op, uint32_t x, uint32_t y)
+{
+    const source_t *source = (const source_t *) (list + op->source);
+
+    if (OP_SCALE_BLIT == op->type) {
+        x = (x * (((uint32_t) source->width << 16) / op->w)) >> 16;
+        y = (y * (((uint32_t) source->height << 16) / op->h)) >> 16;
+    }
+
+    return source->buffer + (y * source->width + x) * (DISPLAY_DEPTH / 8);
+}
+
+/* All operations are opaque. */
+static bool
+covers(const op_t *op, int16_t x0, int16_t y0, uint16_t w, uint16_t h)
+{
+    return op->x0 <= x0 && op->y0 <= y0
+        && op->x0 + op->w >= x0 + w && op->y0 + op->h >= y0 + h;
+}
+
+/* Tiles on the right and bottom edge can be smaller. */
+static void
+tile_rect(uint16_t t, int16_t *x0, int16_t *y0, uint16_t *w, uint16_t *h)
+{
+    *x0 = (t % TILES_X) * TILE_WIDTH;
+    *y0 = (t / TILES_X) * TILE_HEIGHT;
+    *w = DISPLAY_WIDTH - *x0 < TILE_WIDTH ? DISPLAY_WIDTH - *x0 : TILE_WIDTH;
+    *h = DISPLAY_HEIGHT - *y0 < TILE_HEIGHT ? DISPLAY_HEIGHT - *y0 : TILE_HEIGHT;
+}
+
+static void
+bin(void)
+{
+    int16_t x0, y0;
+    uint16_t w, h;
+
+    for (uint16_t t = 0; t < TILES; t++) {
+        first[t] = UINT16_MAX;
+        last[t] = 0;
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+        const op_t *op = &ops[i];
+        /* Scaled blits are not clipped, they can continue past the edges. */
+        const uint16_t tx1 = min((op->x0 + op->w - 1) / TILE_WIDTH, TILES_X - 1);
+        const uint16_t ty1 = min((op->y0 + op->h - 1) / TILE_HEIGHT, TILES_Y - 1);
+
+        for (uint16_t ty = op->y0 / TILE_HEIGHT; ty <= ty1; ty++) {
+            for (uint16_t tx = op->x0 / TILE_WIDTH; tx <= tx1; tx++) {
+                const uint16_t t = ty * TILES_X + tx;
+
+                /* Whatever was drawn before a covering operation is hidden. */
+                tile_rect(t, &x0, &y0, &w, &h);
+                if (UINT16_MAX == first[t] || covers(op, x0, y0, w, h)) {
+                    first[t] = i;
+                }
+                last[t] = i;
+            }
+        }
+    }
+}
+
+static void
+rasterize(const op_t *op, int16_t tx, int16_t ty)
+{
+    const hagl_window_t window = {tx, ty, tx + tile.width - 1, ty + tile.height - 1};
+    const uint8_t bytes = DISPLAY_DEPTH / 8;
+    int16_t x0 = op->x0;
+    int16_t y0 = op->y0;
+    uint16_t w = op->w;
+    uint16_t h = op->h;
+
+    if (!hagl_hal_clip_rect(&window, &x0, &y0, &w, &h)) {
+        return;
+    }
+
+    if (OP_FILL == op->type) {
+        hagl_hal_fill_bitmap(&tile, x0 - tx, y0 - ty, w, h, op->color);
+        return;
+    }
+
+    uint8_t *ptr = tile.buffer + (y0 - ty) * tile.pitch + (x0 - tx) * bytes;
+
+    if (OP_BLIT == op->type) {
+        for (uint16_t y = 0; y < h; y++) {
+            memcpy(ptr, source_pixel(op, x0 - op->x0, y0 - op->y0 + y), w * bytes);
+            ptr += tile.pitch;
+        }
+        return;
+    }
+
+    /* Nearest neighbour scaling in 16.16 fixed point like HAGL itself. */
+    const source_t *source = (const source_t *) (list + op->source);
+    const uint32_t x_ratio = ((uint32_t) source->width << 16) / op->w;
+    const uint32_t y_ratio = ((uint32_t) source->height << 16) / op->h;
+
+    for (uint16_t y = 0; y < h; y++) {
+        const uint32_t sy = ((uint32_t) (y0 - op->y0 + y) * y_ratio) >> 16;
+        const uint8_t *row = source->buffer + sy * source->width * bytes;
+
+        for (uint16_t x = 0; x < w; x++) {
+            const uint32_t sx = ((uint32_t) (x0 - op->x0 + x) * x_ratio) >> 16;
+            memcpy(ptr + x * bytes, row + sx * bytes, bytes);
+        }
+        ptr += tile.pitch;
+    }
+}
+
+static size_t
+flush(void *self)
+{
+    uint16_t first_row, last_row;
+    int16_t x0, y0;
+    uint16_t w, h;
+    size_t size = 0;
+
+    if (dropped) {
+        ESP_LOGW(TAG, "Display list full, %" PRIu32 " operations dropped.", dropped);
+        dropped = 0;
+    }
+
+    bin();
+
+    /* Only tiles with rows shown in partial mode are sent. */
+    mipi_display_get_partial(&display, &first_row, &last_row);
+
+    for (uint16_t t = 0; t < TILES; t++) {
+        const bool touched = UINT16_MAX != first[t];
+
+        tile_rect(t, &x0, &y0, &w, &h);
+
+        /* Empty tile which was already cleared on previous frame. */
+        if (!touched && !shown[t]) {
+            continue;
+        }
+        if (y0 > last_row || y0 + h - 1 < first_row) {
+            continue;
+        }
+
+        /* Wait until the tile buffer is not being sent anymore. */
+        mipi_display_fence_wait(&display, fences[current]);
+        hagl_bitmap_init(&tile, w, h, DISPLAY_DEPTH, buffers[current]);
+
+        if (!touched || !covers(&ops[first[t]], x0, y0, w, h)) {
+            memset(tile.buffer, 0x00, BITMAP_SIZE(w, h, DISPLAY_DEPTH));
+        }
+        if (touched) {
+            for (uint16_t i = first[t]; i <= last[t]; i++) {
+                rasterize(&ops[i], x0, y0);
+            }
+        }
+
+        fences[current] = mipi_display_write_async(&display, x0, y0, w, h, tile.buffer);
+        size += BITMAP_SIZE(w, h, DISPLAY_DEPTH);
+        shown[t] = touched;
+
+        current ^= 1;
+    }
+
+    /* Tiles are already rasterized so the list can be reused while sending. */
+    count = 0;
+    top = LIST_SIZE;
+
+    return size;
+}
+
+static void
+put_pixel(void *self, int16_t x0, int16_t y0, hagl_color_t color)
+{
+    op_t *op = count ? &ops[count - 1] : NULL;
+
+    /* Extend the previous operation if the pixel is next to it. */
+    if (op && OP_FILL == op->type && color == op->color) {
+        if (1 == op->h && y0 == op->y0) {
+            if (x0 == op->x0 + op->w) {
+                op->w++;
+                return;
+            }
+            if (x0 == op->x0 - 1) {
+                op->x0--;
+                op->w++;
+                return;
+            }
+        }
+        if (1 == op->w && x0 == op->x0 && y0 == op->y0 + op->h) {
+            op->h++;
+            return;
+        }
+    }
+
+    record_fill(x0, y0, 1, 1, color);
+}
+
+static hagl_color_t
+get_pixel(void *self, int16_t x0, int16_t y0)
+{
+    hagl_color_t color = 0;
+
+    /* Topmost operation covering the pixel decides the color. */
+    for (uint16_t i = count; i > 0; i--) {
+        const op_t *op = &ops[i - 1];
+
+        if (x0 < op->x0 || y0 < op->y0 || x0 >= op->x0 + op->w || y0 >= op->y0 + op->h) {
+            continue;
+        }
+        if (OP_FILL == op->type) {
+            return op->color;
+        }
+        memcpy(&color, source_pixel(op, x0 - op->x0, y0 - op->y0), DISPLAY_DEPTH / 8);
+        return color;
+    }
+
+    return color;
+}
+
+static void
+blit(void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+{
+    record_bitmap(OP_BLIT, x0, y0, src->width, src->height, src);
+}
+
+static void
+scale_blit(void *self, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
+{
+    /* HAGL does not clip scaled blits, drop the ones completely outside. */
+    if (x0 >= DISPLAY_WIDTH || y0 >= DISPLAY_HEIGHT) {
+        return;
+    }
+    record_bitmap(OP_SCALE_BLIT, x0, y0, w, h, src);
+}
+
+static void
+hline(void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
+{
+    record_fill(x0, y0, width, 1, color);
+}
+
+static void
+vline(void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
+{
+    record_fill(x0, y0, 1, height, color);
+}
+
+void
+hagl_hal_fill_rect(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_color_t color)
+{
+    if (hagl_hal_clip_rect(&backend->clip, &x0, &y0, &w, &h)) {
+        record_fill(x0, y0, w, h, color);
+    }
+}
+
+mipi_display_t *
+hagl_hal_get_display(hagl_backend_t *backend)
+{
+    (void) backend;
+    return &display;
+}
+
+void
+hagl_hal_standby(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, bool idle)
+{
+    const hagl_window_t screen = {0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1};
+
+    if (hagl_hal_clip_rect(&screen, &x0, &y0, &w, &h)) {
+        mipi_display_enter_partial(&display, x0, y0, x0 + w - 1, y0 + h - 1, idle);
+        hagl_set_clip(backend, x0, y0, x0 + w - 1, y0 + h - 1);
+    }
+}
+
+void
+hagl_hal_wake(hagl_backend_t *backend)
+{
+    mipi_display_exit_partial(&display);
+    hagl_set_clip(backend, 0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1);
+}
+
+void
+hagl_hal_init(hagl_backend_t *backend)
+{
+    const mipi_display_config_t config = MIPI_DISPLAY_CONFIG_DEFAULT();
+
+    mipi_display_init(&display, &config);
+
+    ESP_LOGI(
+        TAG, "Tiled buffering mode, %dx%d tiles, %d byte display list",
+        TILE_WIDTH, TILE_HEIGHT, LIST_SIZE
+    );
+
+    list = (uint8_t *) heap_caps_malloc(LIST_SIZE, MALLOC_CAP_32BIT);
+    if (NULL == list) {
+        ESP_LOGE(TAG, "Failed to alloc display list.");
+    } else {
+        ESP_LOGI(TAG, "Display list at: %p", list);
+    };
+    ops = (op_t *) list;
+
+    for (uint8_t i = 0; i < 2; i++) {
+        buffers[i] = (uint8_t *) heap_caps_malloc(
+                BITMAP_SIZE(TILE_WIDTH, TILE_HEIGHT, DISPLAY_DEPTH),
+                MALLOC_CAP_DMA | MALLOC_CAP_32BIT
+            );
+        if (NULL == buffers[i]) {
+            ESP_LOGE(TAG, "Failed to alloc tile buffer %d.", i + 1);
+        } else {
+            ESP_LOGI(TAG, "Tile buffer %d at: %p", i + 1, buffers[i]);
+        };
+        fences[i] = 0;
+    }
+
+    /* Whatever was on the display is cleared by the first flush. */
+    for (uint16_t t = 0; t < TILES; t++) {
+        shown[t] = true;
+    }
+
+    backend->buffer = buffers[0];
+    backend->width = MIPI_DISPLAY_WIDTH;
+    backend->height = MIPI_DISPLAY_HEIGHT;
+    backend->depth = MIPI_DISPLAY_DEPTH;
+    backend->put_pixel = put_pixel;
+    backend->get_pixel = get_pixel;
+    backend->hline = hline;
+    backend->vline = vline;
+    backend->blit = blit;
+    backend->scale_blit = scale_blit;
+    backend->flush = flush;
+
+    hagl_bitmap_init(&tile, TILE_WIDTH, TILE_HEIGHT, DISPLAY_DEPTH, buffers[0]);
+}
+
+#endif /* CONFIG_HAGL_HAL_USE_TILED_BUFFERING */
@@ -35,6 +35,15 @@ This is the HAL used when triple buffering is enabled. The GRAM of the
 display driver chip is the framebuffer. The two memory blocks allocated
 by this HAL are the two back buffer. Total three buffers.
 
+Finished back buffer is sent to the display by a separate flush task
+while drawing continues to the other one. If the flush task is still
+busy when flushing the frame is counted as dropped and drawing continues
+to the same buffer. Newest frame is then presented on the next flush.
+
+Optionally the areas drawn to each frame are tracked. After a swap the
+back buffer lacks the areas drawn to the frame being sent. These can be
+copied from that frame so only the changes need to be drawn.
+
 Note that all coordinates are already clipped in the main library itself.
 HAL does not need to validate the coordinates, they can alway be assumed
 valid.
@@ -48,6 +57,8 @@ valid.
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 #include <esp_log.h>
 #include <esp_heap_caps.h>
 #include <string.h>
@@ -55,80 +66,365 @@ valid.
 #include <hagl/bitmap.h>
 #include <hagl.h>
 
+#include "hagl_hal_pixel.h"
+
 
 static uint8_t *buffer1;
 static uint8_t *buffer2;
 
 static hagl_bitmap_t bb;
 
-static spi_device_handle_t spi;
+static mipi_display_t display;
 static const char *TAG = "hagl_esp_mipi";
 
+static QueueHandle_t mailbox;
+static SemaphoreHandle_t idle;
+static volatile uint32_t presented = 0;
+static volatile uint32_t dropped = 0;
+
+#ifdef CONFIG_HAGL_HAL_ROW_HASH
+/* Hash of each row last sent to the display. */
+static uint32_t hashes[DISPLAY_HEIGHT];
+#endif /* CONFIG_HAGL_HAL_ROW_HASH */
+
+#ifdef CONFIG_HAGL_HAL_BUFFER_AGE
+typedef struct {
+    hagl_window_t areas[CONFIG_HAGL_HAL_DAMAGE_RECTANGLES_MAX];
+    uint8_t count;
+    bool full;
+} damage_t;
+
+/* Areas drawn since the last swap. */
+static damage_t drawn;
+/* Areas where the back buffer differs from the newest frame. */
+static damage_t damage = {.full = true};
+static uint8_t age = 0;
+static uint8_t swaps = 0;
+
+static inline int
+min(int a, int b)
+{
+    return (a > b) ? b : a;
+}
+
+static inline int
+max(int a, int b)
+{
+    return (a > b) ? a : b;
+}
+
+static void
+drawn_add(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    if (drawn.full) {
+        return;
+    }
+
+    /* Scaled blits are not clipped, keep the area inside the buffer. */
+    if (x0 >= bb.width || y0 >= bb.height) {
+        return;
+    }
+    x1 = min(x1, bb.width - 1);
+    y1 = min(y1, bb.height - 1);
+
+    /* Already inside a known area, nothing to do. */
+    for (uint8_t i = 0; i < drawn.count; i++) {
+        if (x0 >= drawn.areas[i].x0 && x1 <= drawn.areas[i].x1 &&
+            y0 >= drawn.areas[i].y0 && y1 <= drawn.areas[i].y1) {
+            return;
+        }
+    }
+
+    /* Merge with all overlapping or touching areas. */
+    uint8_t i = 0;
+    while (i < drawn.count) {
+        hagl_window_t *area = &drawn.areas[i];
+        if (x0 <= area->x1 + 1 && area->x0 <= x1 + 1 &&
+            y0 <= area->y1 + 1 && area->y0 <= y1 + 1) {
+            x0 = min(x0, area->x0);
+            y0 = min(y0, area->y0);
+            x1 = max(x1, area->x1);
+            y1 = max(y1, area->y1);
+
+            /* Remove the merged area and start over with the grown one. */
+            *area = drawn.areas[--drawn.count];
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+
+    /* Too many separate areas, whole frame is damaged. */
+    if (CONFIG_HAGL_HAL_DAMAGE_RECTANGLES_MAX == drawn.count) {
+        drawn.full = true;
+        return;
+    }
+
+    drawn.areas[drawn.count].x0 = x0;
+    drawn.areas[drawn.count].y0 = y0;
+    drawn.areas[drawn.count].x1 = x1;
+    drawn.areas[drawn.count].y1 = y1;
+    drawn.count++;
+}
+
+static void
+damage_swap(bool swapped)
+{
+    if (!swapped) {
+        /* Back buffer keeps the newest frame which was not sent. */
+        age = 1;
+        damage.count = 0;
+        damage.full = false;
+        return;
+    }
+
+    /* New back buffer lacks everything drawn to the frame being sent. */
+    damage = drawn;
+    drawn.count = 0;
+    drawn.full = false;
+
+    /* Before the second swap the new back buffer was never sent. */
+    if (swaps < 2) {
+        swaps++;
+    }
+    age = (2 == swaps) ? 2 : 0;
+    damage.full |= (0 == age);
+}
+
+uint8_t
+hagl_hal_buffer_age(hagl_backend_t *backend)
+{
+    (void) backend;
+    return age;
+}
+
+uint8_t
+hagl_hal_get_damage(hagl_backend_t *backend, hagl_window_t *areas)
+{
+    (void) backend;
+
+    if (damage.full) {
+        areas[0].x0 = 0;
+        areas[0].y0 = 0;
+        areas[0].x1 = DISPLAY_WIDTH - 1;
+        areas[0].y1 = DISPLAY_HEIGHT - 1;
+        return 1;
+    }
+
+    memcpy(areas, damage.areas, damage.count * sizeof(hagl_window_t));
+    return damage.count;
+}
+
+void
+hagl_hal_copy_damage(hagl_backend_t *backend)
+{
+    hagl_window_t areas[CONFIG_HAGL_HAL_DAMAGE_RECTANGLES_MAX];
+    /* Flush task only reads the newest frame, it is safe to copy from. */
+    const uint8_t *newest = (bb.buffer == buffer1) ? buffer2 : buffer1;
+    const uint8_t count = hagl_hal_get_damage(backend, areas);
+
+    /* Nothing has been sent yet, there is no newest frame. */
+    if (0 == swaps) {
+        return;
+    }
+
+    hagl_hal_dma_wait_all();
+
+    for (uint8_t i = 0; i < count; i++) {
+        const size_t offset = areas[i].x0 * DISPLAY_DEPTH / 8;
+        const size_t line = (areas[i].x1 - areas[i].x0 + 1) * DISPLAY_DEPTH / 8;
+
+        for (uint16_t y = areas[i].y0; y <= areas[i].y1; y++) {
+            memcpy(bb.buffer + y * bb.pitch + offset, newest + y * bb.pitch + offset, line);
+        }
+    }
+
+    age = 1;
+    damage.count = 0;
+    damage.full = false;
+}
+#else
+#define drawn_add(x0, y0, x1, y1)
+#define damage_swap(swapped)
+#endif /* CONFIG_HAGL_HAL_BUFFER_AGE */
+
+static void
+flush_task(void *params)
+{
+    uint8_t *buffer;
+#ifdef CONFIG_HAGL_HAL_ROW_HASH
+    bool hashed = false;
+#else
+    uint32_t fence;
+#endif /* CONFIG_HAGL_HAL_ROW_HASH */
+
+    (void) params;
+
+    while (1) {
+        xQueueReceive(mailbox, &buffer, portMAX_DELAY);
+        mipi_display_vsync_wait(&display);
+
+#ifdef CONFIG_HAGL_HAL_ROW_HASH
+        /* Send only the rows which differ from what display has. */
+        mipi_display_write_changed(&display, 0, bb.height, buffer, hashes, !hashed);
+        hashed = true;
+#else
+        /* Wait for DMA without spinning so the core stays usable. */
+        fence = mipi_display_write_async(&display, 0, 0, bb.width, bb.height, buffer);
+        mipi_display_fence_wait(&display, fence);
+#endif /* CONFIG_HAGL_HAL_ROW_HASH */
+
+        presented++;
+        xSemaphoreGive(idle);
+    }
+}
+
 static size_t
 flush(void *self)
 {
+    /*
+     * Flush task is still sending the other buffer. Keep drawing to the
+     * current one, the newest frame is presented on next flush.
+     */
+    if (pdFALSE == xSemaphoreTake(idle, 0)) {
+        dropped++;
+        damage_swap(false);
+        return 0;
+    }
+
+    /* Blits still being copied must be in the buffer before handing it over. */
+    hagl_hal_dma_wait_all();
+
     uint8_t *buffer = bb.buffer;
     if (bb.buffer == buffer1) {
         bb.buffer = buffer2;
     } else {
         bb.buffer = buffer1;
     }
-    return mipi_display_write(spi, 0, 0, bb.width, bb.height, (uint8_t *) buffer);
+    damage_swap(true);
+
+    /* Hand the finished buffer to the flush task. */
+    xQueueOverwrite(mailbox, &buffer);
+    return BITMAP_SIZE(bb.width, bb.height, bb.depth);
+}
+
+void
+hagl_hal_get_frame_stats(hagl_hal_frame_stats_t *stats)
+{
+    stats->presented = presented;
+    stats->dropped = dropped;
+}
+
+void
+hagl_hal_reset_frame_stats(void)
+{
+    presented = 0;
+    dropped = 0;
 }
 
 static void
 put_pixel(void *self, int16_t x0, int16_t y0, hagl_color_t color)
 {
-    bb.put_pixel(&bb, x0, y0, color);
+    hagl_hal_put_pixel(&bb, x0, y0, color);
+    drawn_add(x0, y0, x0, y0);
 }
 
 static hagl_color_t
 get_pixel(void *self, int16_t x0, int16_t y0)
 {
-    return bb.get_pixel(&bb, x0, y0);
+    return hagl_hal_get_pixel(&bb, x0, y0);
 }
 
 static void
 blit(void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
 {
-    bb.blit(&bb, x0, y0, src);
+    hagl_hal_blit(&bb, x0, y0, src);
+    drawn_add(x0, y0, x0 + src->width - 1, y0 + src->height - 1);
 }
 
 static void
 scale_blit(void *self, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
 {
-    bb.scale_blit(&bb, x0, y0, w, h, src);
+    hagl_hal_dma_wait(x0, y0, x0 + w - 1, y0 + h - 1);
+    hagl_hal_scale_blit(&bb, x0, y0, w, h, src);
+    drawn_add(x0, y0, x0 + w - 1, y0 + h - 1);
 }
 
 static void
 hline(void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
 {
-    bb.hline(&bb, x0, y0, width, color);
+    hagl_hal_dma_wait(x0, y0, x0 + width - 1, y0);
+    hagl_hal_fill_bitmap(&bb, x0, y0, width, 1, color);
+    drawn_add(x0, y0, x0 + width - 1, y0);
 }
 
 
 static void
 vline(void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
 {
-    bb.vline(&bb, x0, y0, height, color);
+    hagl_hal_vline(&bb, x0, y0, height, color);
+    drawn_add(x0, y0, x0, y0 + height - 1);
+}
+
+void
+hagl_hal_fill_rect(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_color_t color)
+{
+    if (hagl_hal_clip_rect(&backend->clip, &x0, &y0, &w, &h)) {
+        hagl_hal_dma_wait(x0, y0, x0 + w - 1, y0 + h - 1);
+        hagl_hal_fill_bitmap(&bb, x0, y0, w, h, color);
+        drawn_add(x0, y0, x0 + w - 1, y0 + h - 1);
+    }
+}
+
+#ifdef CONFIG_HAGL_HAL_DMA_BLIT
+void
+hagl_hal_blit_async(hagl_backend_t *backend, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+{
+    const hagl_window_t *clip = &backend->clip;
+
+    /* HAGL clips partially visible bitmaps pixel by pixel. */
+    if (x0 < clip->x0 || y0 < clip->y0 || x0 + src->width - 1 > clip->x1 || y0 + src->height - 1 > clip->y1) {
+        hagl_blit(backend, x0, y0, src);
+        return;
+    }
+    if (!hagl_hal_dma_blit(&bb, x0, y0, src)) {
+        hagl_hal_blit_cpu(&bb, x0, y0, src);
+    }
+    drawn_add(x0, y0, x0 + src->width - 1, y0 + src->height - 1);
 }
+#endif /* CONFIG_HAGL_HAL_DMA_BLIT */
 
-// void hagl_hal_clear_screen()
-// {
-//     hagl_color_t *ptr1 = (hagl_color_t *) buffer1;
-//     hagl_color_t *ptr2 = (hagl_color_t *) buffer2;
-//     size_t count = DISPLAY_WIDTH * DISPLAY_HEIGHT;
+mipi_display_t *
+hagl_hal_get_display(hagl_backend_t *backend)
+{
+    (void) backend;
+    return &display;
+}
 
-//     while (--count) {
-//         *ptr1++ = 0x0000;
-//         *ptr2++ = 0x0000;
-//     }
-// }
+void
+hagl_hal_standby(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h, bool idle)
+{
+    const hagl_window_t screen = {0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1};
+
+    if (hagl_hal_clip_rect(&screen, &x0, &y0, &w, &h)) {
+        mipi_display_enter_partial(&display, x0, y0, x0 + w - 1, y0 + h - 1, idle);
+        hagl_set_clip(backend, x0, y0, x0 + w - 1, y0 + h - 1);
+    }
+}
+
+void
+hagl_hal_wake(hagl_backend_t *backend)
+{
+    mipi_display_exit_partial(&display);
+    hagl_set_clip(backend, 0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1);
+}
 
 void
 hagl_hal_init(hagl_backend_t *backend)
 {
-    mipi_display_init(&spi);
+    const mipi_display_config_t config = MIPI_DISPLAY_CONFIG_DEFAULT();
+
+    mipi_display_init(&display, &config);
 
     ESP_LOGI(TAG, "Triple buffering mode");
     ESP_LOGI(
@@ -143,7 +439,7 @@ hagl_hal_init(hagl_backend_t *backend)
 
     buffer1 = (uint8_t *) heap_caps_malloc(
             BITMAP_SIZE(DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_DEPTH),
-            MALLOC_CAP_DMA | MALLOC_CAP_32BIT
+            HAGL_HAL_BACK_BUFFER_CAPS
         );
     if (NULL == buffer1) {
         ESP_LOGE(TAG, "Failed to alloc buffer 1.");
@@ -164,7 +460,7 @@ hagl_hal_init(hagl_backend_t *backend)
 
     buffer2 = (uint8_t *) heap_caps_malloc(
             BITMAP_SIZE(DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_DEPTH),
-            MALLOC_CAP_DMA | MALLOC_CAP_32BIT
+            HAGL_HAL_BACK_BUFFER_CAPS
         );
 
     if (NULL == buffer2) {
@@ -187,6 +483,23 @@ hagl_hal_init(hagl_backend_t *backend)
     backend->flush = flush;
 
     hagl_bitmap_init(&bb, backend->width, backend->height, backend->depth, backend->buffer);
+    hagl_hal_dma_init();
+
+    mailbox = xQueueCreate(1, sizeof(uint8_t *));
+    idle = xSemaphoreCreateBinary();
+    xSemaphoreGive(idle);
+
+#if CONFIG_HAGL_HAL_FLUSH_TASK_CORE < 0
+    xTaskCreate(
+        flush_task, "flush_task", CONFIG_HAGL_HAL_FLUSH_TASK_STACK_SIZE, NULL,
+        CONFIG_HAGL_HAL_FLUSH_TASK_PRIORITY, NULL
+    );
+#else
+    xTaskCreatePinnedToCore(
+        flush_task, "flush_task", CONFIG_HAGL_HAL_FLUSH_TASK_STACK_SIZE, NULL,
+        CONFIG_HAGL_HAL_FLUSH_TASK_PRIORITY, NULL, CONFIG_HAGL_HAL_FLUSH_TASK_CORE
+    );
+#endif /* CONFIG_HAGL_HAL_FLUSH_TASK_CORE < 0 */
 }
 
 #endif /* #ifdef CONFIG_HAGL_HAL_USE_TRIPLE_BUFFERING */
\ No newline at end of file
@@ -43,19 +43,27 @@ SPDX-License-Identifier: MIT
 #include <freertos/semphr.h>
 #include <freertos/task.h>
 #include <esp_system.h>
-#include <driver/spi_master.h>
 #include <driver/ledc.h>
 #include <soc/gpio_struct.h>
 #include <driver/gpio.h>
 #include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_idf_version.h>
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include <esp_memory_utils.h>
+#else
+#include <soc/soc_memory_layout.h>
+#endif
 #include <esp_rom_gpio.h>
+#include <esp_attr.h>
+#include <esp_timer.h>
 
 #include "sdkconfig.h"
 #include "mipi_dcs.h"
 #include "mipi_display.h"
+#include "mipi_display_transport.h"
 
 static const char *TAG = "mipi_display";
-static SemaphoreHandle_t mutex;
 
 static inline int
 min(int a, int b)
@@ -63,248 +71,827 @@ min(int a, int b)
     return (a > b) ? b : a;
 }
 
-static void
-mipi_display_write_command(spi_device_handle_t spi, const uint8_t command)
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+static void IRAM_ATTR
+mipi_display_stats_flush(mipi_display_t *display, int64_t started)
 {
-    spi_transaction_t transaction = {
-        .length = 8,
-        .flags = SPI_TRANS_USE_TXDATA,
-        .tx_data = {command},
-    };
+    mipi_display_stats_t *stats = &display->stats;
+    uint32_t elapsed = esp_timer_get_time() - started;
 
-    ESP_LOGD(TAG, "Sending command 0x%02x", command);
+    stats->flushes++;
+    stats->flush_total_us += elapsed;
+    if (elapsed < stats->flush_min_us) {
+        stats->flush_min_us = elapsed;
+    }
+    if (elapsed > stats->flush_max_us) {
+        stats->flush_max_us = elapsed;
+    }
+}
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
 
-    /* Set DC low to denote a command. */
-    gpio_set_level(CONFIG_MIPI_DISPLAY_PIN_DC, 0);
-    ESP_ERROR_CHECK(spi_device_polling_transmit(spi, &transaction));
+void IRAM_ATTR
+mipi_display_fence_complete(mipi_display_t *display, uint32_t fence, BaseType_t *woken)
+{
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+    mipi_display_stats_flush(display, display->flush_started);
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
+    display->fence_completed = fence;
+    xSemaphoreGiveFromISR(display->mutex, woken);
 }
 
 static void
-mipi_display_write_data(spi_device_handle_t spi, const uint8_t *data, size_t length)
+mipi_display_collect(mipi_display_t *display)
 {
-    if (0 == length) {
-        return;
-    };
+    mipi_display_wait(display, display->sequence);
+}
 
-    /* Set DC high to denote data. */
-    gpio_set_level(CONFIG_MIPI_DISPLAY_PIN_DC, 1);
+#ifdef CONFIG_MIPI_DISPLAY_TE_SYNC
+static void IRAM_ATTR
+mipi_display_te_isr(void *arg)
+{
+    mipi_display_t *display = arg;
+    BaseType_t woken = pdFALSE;
 
-    for (size_t i = 0; i < length; i += SPI_MAX_TRANSFER_SIZE) {
-        size_t chunk = min(SPI_MAX_TRANSFER_SIZE, length - i);
+    xSemaphoreGiveFromISR(display->tear, &woken);
+    if (pdTRUE == woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+#endif /* CONFIG_MIPI_DISPLAY_TE_SYNC */
 
-        spi_transaction_t transaction = {
-            .length = chunk * 8,
-            .tx_buffer = data + i,
-            .rx_buffer = NULL
-        };
+static void
+mipi_display_lock(mipi_display_t *display)
+{
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+    int64_t started = esp_timer_get_time();
+    xSemaphoreTake(display->mutex, portMAX_DELAY);
+    display->stats.lock_wait_us += esp_timer_get_time() - started;
+#else
+    xSemaphoreTake(display->mutex, portMAX_DELAY);
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
 
-        ESP_ERROR_CHECK(spi_device_polling_transmit(spi, &transaction));
-        //ESP_ERROR_CHECK(spi_device_queue_trans(spi, &transaction, portMAX_DELAY));
-        ESP_LOG_BUFFER_HEX_LEVEL(TAG, data + i, chunk, ESP_LOG_VERBOSE);
-    }
+    /* Collect the results of previous asynchronous write. */
+    mipi_display_collect(display);
 }
 
 static void
-mipi_display_read_data(spi_device_handle_t spi, uint8_t *data, size_t length)
+mipi_display_unlock(mipi_display_t *display)
 {
-    if (0 == length) {
-        return;
-    };
+    xSemaphoreGive(display->mutex);
+}
+
+/*
+ * Bounce buffers are allocated when first needed so that they do not take
+ * internal memory from those who never send data which DMA cannot read.
+ */
+static void
+mipi_display_bounce_alloc(mipi_display_t *display)
+{
+    for (uint8_t i = 0; i < 2; i++) {
+        display->bounce[i] = (uint8_t *) heap_caps_malloc(
+            display->config.bounce_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL
+        );
+        if (NULL == display->bounce[i]) {
+            ESP_LOGE(TAG, "Failed to alloc bounce buffer %d.", i + 1);
+        }
+    }
 
-    spi_transaction_t transaction = {
-        .length = 0, /* no tx */
-        .rxlength = length * 8,/* length in bits */
-        .rx_buffer = data,
-    };
+    /* Without both of them data is sent as is, do not try again. */
+    if (NULL == display->bounce[0] || NULL == display->bounce[1]) {
+        heap_caps_free(display->bounce[0]);
+        heap_caps_free(display->bounce[1]);
+        display->bounce[0] = display->bounce[1] = NULL;
+        display->config.bounce_size = 0;
+    }
+}
 
-    /* Set DC high to denote data. */
-    gpio_set_level(CONFIG_MIPI_DISPLAY_PIN_DC, 1);
+/* True if the data must be copied to a bounce buffer before sending. */
+static bool
+mipi_display_bounced(mipi_display_t *display, const uint8_t *data)
+{
+    if (0 == display->config.bounce_size || esp_ptr_dma_capable(data)) {
+        return false;
+    }
+    if (NULL == display->bounce[0]) {
+        mipi_display_bounce_alloc(display);
+    }
+    return NULL != display->bounce[0];
+}
 
-    ESP_ERROR_CHECK(spi_device_polling_transmit(spi, &transaction));
+/*
+ * Copies rows which DMA cannot read, for example from PSRAM, to the two
+ * internal bounce buffers and queues them. Next bounce buffer is filled
+ * while the previous one is being sent. Rows can be apart by pitch.
+ */
+static void
+mipi_display_queue_bounced(mipi_display_t *display, const uint8_t *data, size_t line, size_t pitch, uint16_t rows, uint32_t fence)
+{
+    const size_t size = display->config.bounce_size;
+    uint16_t row = 0;
+    size_t offset = 0;
+
+    while (row < rows) {
+        const uint8_t next = display->bounce_next;
+        uint8_t *bounce = display->bounce[next];
+        size_t filled = 0;
+
+        /* Wait until the transaction last sending this buffer is done. */
+        mipi_display_wait(display, display->bounce_sequence[next]);
+
+        while (row < rows && filled < size) {
+            const size_t chunk = min(size - filled, line - offset);
+
+            memcpy(bounce + filled, data + row * pitch + offset, chunk);
+            filled += chunk;
+            offset += chunk;
+            if (offset == line) {
+                offset = 0;
+                row++;
+            }
+        }
+
+        mipi_display_queue(display, 1, bounce, filled, (row == rows) ? fence : 0);
+        display->bounce_sequence[next] = display->sequence;
+        display->bounce_next = next ^ 1;
+
+        STATS_ADD(bounced_bytes, filled);
+    }
 }
 
 static void
-mipi_display_set_address(spi_device_handle_t spi, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
+mipi_display_set_address(mipi_display_t *display, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
 {
     uint8_t data[4];
-    static uint16_t prev_x1, prev_x2, prev_y1, prev_y2;
 
-    x1 = x1 + CONFIG_MIPI_DISPLAY_OFFSET_X;
-    y1 = y1 + CONFIG_MIPI_DISPLAY_OFFSET_Y;
-    x2 = x2 + CONFIG_MIPI_DISPLAY_OFFSET_X;
-    y2 = y2 + CONFIG_MIPI_DISPLAY_OFFSET_Y;
+    x1 = x1 + display->config.offset_x;
+    y1 = y1 + display->config.offset_y;
+    x2 = x2 + display->config.offset_x;
+    y2 = y2 + display->config.offset_y;
 
     /* Change column address only if it has changed. */
-    if ((prev_x1 != x1 || prev_x2 != x2)) {
-        mipi_display_write_command(spi, MIPI_DCS_SET_COLUMN_ADDRESS);
+    if ((display->prev_x1 != x1 || display->prev_x2 != x2)) {
+        mipi_display_queue(display, 0, &(uint8_t) {MIPI_DCS_SET_COLUMN_ADDRESS}, 1, 0);
         data[0] = x1 >> 8;
         data[1] = x1 & 0xff;
         data[2] = x2 >> 8;
         data[3] = x2 & 0xff;
-        mipi_display_write_data(spi, data, 4);
+        mipi_display_queue(display, 1, data, 4, 0);
 
-        prev_x1 = x1;
-        prev_x2 = x2;
+        display->prev_x1 = x1;
+        display->prev_x2 = x2;
+
+        STATS_ADD(address_misses, 1);
+    } else {
+        STATS_ADD(address_hits, 1);
     }
 
     /* Change page address only if it has changed. */
-    if ((prev_y1 != y1 || prev_y2 != y2)) {
-        mipi_display_write_command(spi, MIPI_DCS_SET_PAGE_ADDRESS);
+    if ((display->prev_y1 != y1 || display->prev_y2 != y2)) {
+        mipi_display_queue(display, 0, &(uint8_t) {MIPI_DCS_SET_PAGE_ADDRESS}, 1, 0);
         data[0] = y1 >> 8;
         data[1] = y1 & 0xff;
         data[2] = y2 >> 8;
         data[3] = y2 & 0xff;
-        mipi_display_write_data(spi, data, 4);
+        mipi_display_queue(display, 1, data, 4, 0);
+
+        display->prev_y1 = y1;
+        display->prev_y2 = y2;
 
-        prev_y1 = y1;
-        prev_y2 = y2;
+        STATS_ADD(address_misses, 1);
+    } else {
+        STATS_ADD(address_hits, 1);
     }
 
-    mipi_display_write_command(spi, MIPI_DCS_WRITE_MEMORY_START);
+    mipi_display_queue(display, 0, &(uint8_t) {MIPI_DCS_WRITE_MEMORY_START}, 1, 0);
+}
+
+/*
+ * Clips rows to those shown in partial mode. Returns the number of rows
+ * skipped from the top. Height is set to zero if nothing is left.
+ */
+static uint16_t
+mipi_display_clip_partial(mipi_display_t *display, uint16_t *y1, uint16_t *h)
+{
+    const uint16_t skip = (*y1 < display->partial_y1) ? display->partial_y1 - *y1 : 0;
+
+    if (skip >= *h || *y1 + skip > display->partial_y2) {
+        *h = 0;
+        return 0;
+    }
+
+    *y1 += skip;
+    *h = min(*h - skip, display->partial_y2 - *y1 + 1);
+
+    return skip;
+}
+
+/*
+ * Rows inside the scroll area are remapped to the GRAM rows currently
+ * shown there. Returns how many rows starting from y are contiguous in
+ * GRAM, at most until y2. First of those rows is stored to row.
+ */
+static uint16_t
+mipi_display_scroll_run(mipi_display_t *display, uint16_t y, uint16_t y2, uint16_t *row)
+{
+    const uint16_t scroll_bottom = display->scroll_top + display->scroll_height;
+
+    if (0 == display->scroll_height || y >= scroll_bottom) {
+        *row = y;
+        return y2 - y + 1;
+    }
+
+    if (y < display->scroll_top) {
+        *row = y;
+        return min(y2, display->scroll_top - 1) - y + 1;
+    }
+
+    *row = display->scroll_top +
+        (y - display->scroll_top + display->scroll_offset) % display->scroll_height;
+
+    /* Stop at the end of scroll area or where GRAM wraps around. */
+    uint16_t last = min(scroll_bottom - 1, y + scroll_bottom - *row - 1);
+    return min(y2, last) - y + 1;
 }
 
 size_t
-mipi_display_write(spi_device_handle_t spi, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, const uint8_t *buffer)
+mipi_display_write(mipi_display_t *display, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, const uint8_t *buffer)
+{
+    return mipi_display_write_region(display, x1, y1, w, h, w * DISPLAY_DEPTH / 8, buffer);
+}
+
+/*
+ * Queues the pixel data to be sent with DMA and returns immediately. The
+ * buffer must not be changed until the returned fence has completed. The
+ * display is locked until the last chunk has been sent.
+ */
+uint32_t
+mipi_display_write_async(mipi_display_t *display, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, const uint8_t *buffer)
 {
+    buffer += mipi_display_clip_partial(display, &y1, &h) * w * DISPLAY_DEPTH / 8;
+
     if (0 == w || 0 == h) {
-        return 0;
+        return display->fence_completed;
     }
 
     const uint16_t x2 = x1 + w - 1;
     const uint16_t y2 = y1 + h - 1;
-    const size_t size = w * h * DISPLAY_DEPTH / 8;
+    const size_t line = w * DISPLAY_DEPTH / 8;
+    uint16_t row, rows;
+
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+    int64_t started = esp_timer_get_time();
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
+
+    mipi_display_lock(display);
 
-    xSemaphoreTake(mutex, portMAX_DELAY);
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+    display->flush_started = started;
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
 
-    mipi_display_set_address(spi, x1, y1, x2, y2);
-    mipi_display_write_data(spi, buffer, size);
+    /* Zero is reserved for polling transactions. */
+    if (0 == ++display->fence_submitted) {
+        ++display->fence_submitted;
+    }
+
+    for (uint16_t y = y1; y <= y2; y += rows) {
+        rows = mipi_display_scroll_run(display, y, y2, &row);
+        mipi_display_set_address(display, x1, row, x2, row + rows - 1);
+
+        /* Last chunk releases the lock when sent. */
+        const uint32_t fence = (y + rows > y2) ? display->fence_submitted : 0;
+        if (mipi_display_bounced(display, buffer)) {
+            mipi_display_queue_bounced(display, buffer + (y - y1) * line, line, line, rows, fence);
+        } else {
+            mipi_display_queue(display, 1, buffer + (y - y1) * line, rows * line, fence);
+        }
+    }
 
-    xSemaphoreGive(mutex);
+    return display->fence_submitted;
+}
+
+bool
+mipi_display_fence_done(mipi_display_t *display, uint32_t fence)
+{
+    return (int32_t) (display->fence_completed - fence) >= 0;
+}
+
+void
+mipi_display_fence_wait(mipi_display_t *display, uint32_t fence)
+{
+    if (mipi_display_fence_done(display, fence)) {
+        return;
+    }
+
+    /* Lock is released when the last chunk has been sent. */
+    xSemaphoreTake(display->mutex, portMAX_DELAY);
+    xSemaphoreGive(display->mutex);
+}
+
+static uint32_t
+mipi_display_hash(const uint8_t *data, size_t length)
+{
+    uint32_t hash = 2166136261;
+    uint32_t word;
+
+    /*
+     * FNV-1a over whole words and then the remaining bytes. Rows are not
+     * always word aligned, for example 135 pixels wide at 16 bits, so the
+     * words are loaded with memcpy().
+     */
+    for (size_t i = 0; i < length / 4; i++) {
+        memcpy(&word, data + i * 4, sizeof(word));
+        hash = (hash ^ word) * 16777619;
+    }
+    for (size_t i = length & ~3; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619;
+    }
+
+    return hash;
+}
+
+/*
+ * Sends only the full width rows starting from y1 whose hash differs from
+ * the one stored in hashes. Buffer starts from row y1, hashes from row
+ * zero. Adjacent changed rows are sent as one window. If force is true
+ * all rows are sent. Rows outside of the partial area are not sent and
+ * keep their old hash so that they are sent once shown again. Returns the
+ * number of bytes sent.
+ */
+size_t
+mipi_display_write_changed(mipi_display_t *display, uint16_t y1, uint16_t h, const uint8_t *buffer, uint32_t *hashes, bool force)
+{
+    const uint16_t width = display->config.width;
+    const size_t line = width * DISPLAY_DEPTH / 8;
+    size_t size = 0;
+    uint16_t first = 0;
+    uint16_t count = 0;
+
+    for (uint16_t y = y1; y < y1 + h; y++) {
+        const bool shown = y >= display->partial_y1 && y <= display->partial_y2;
+        const uint32_t hash = shown ? mipi_display_hash(buffer + (y - y1) * line, line) : 0;
+
+        if (shown && (force || hash != hashes[y])) {
+            hashes[y] = hash;
+            if (0 == count) {
+                first = y;
+            }
+            count++;
+        } else if (count) {
+            size += mipi_display_write(display, 0, first, width, count, buffer + (first - y1) * line);
+            count = 0;
+        }
+    }
+
+    if (count) {
+        size += mipi_display_write(display, 0, first, width, count, buffer + (first - y1) * line);
+    }
 
     return size;
 }
 
-static void
-mipi_display_spi_master_init(spi_device_handle_t *spi)
-{
-    spi_bus_config_t buscfg = {
-        .miso_io_num = CONFIG_MIPI_DISPLAY_PIN_MISO,
-        .mosi_io_num = CONFIG_MIPI_DISPLAY_PIN_MOSI,
-        .sclk_io_num = CONFIG_MIPI_DISPLAY_PIN_CLK,
-        .quadwp_io_num = -1,
-        .quadhd_io_num = -1,
-        /* Max transfer size in bytes. */
-        .max_transfer_sz = SPI_MAX_TRANSFER_SIZE,
-        .flags = 0
-    };
-    spi_device_interface_config_t devcfg = {
-        .clock_speed_hz = CONFIG_MIPI_DISPLAY_SPI_CLOCK_SPEED_HZ,
-        .mode = CONFIG_MIPI_DISPLAY_SPI_MODE,
-        .spics_io_num = CONFIG_MIPI_DISPLAY_PIN_CS,
-        .queue_size = 8,
-        .flags = SPI_DEVICE_NO_DUMMY
-    };
-
-    /* ESP32S2 requires DMA channel to match the SPI host. */
-    ESP_ERROR_CHECK(spi_bus_initialize(CONFIG_MIPI_DISPLAY_SPI_HOST, &buscfg, SPI_DMA_CH_AUTO));
-    ESP_ERROR_CHECK(spi_bus_add_device(CONFIG_MIPI_DISPLAY_SPI_HOST, &devcfg, spi));
-
-    ESP_LOGI(TAG, "SPI_MAX_TRANSFER_SIZE: %d", SPI_MAX_TRANSFER_SIZE);
+size_t
+mipi_display_write_region(mipi_display_t *display, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, uint16_t pitch, const uint8_t *buffer)
+{
+    buffer += mipi_display_clip_partial(display, &y1, &h) * pitch;
+
+    if (0 == w || 0 == h) {
+        return 0;
+    }
+
+    const uint16_t x2 = x1 + w - 1;
+    const uint16_t y2 = y1 + h - 1;
+    const size_t line = w * DISPLAY_DEPTH / 8;
+    uint16_t row, rows;
+
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+    int64_t started = esp_timer_get_time();
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
+
+    mipi_display_lock(display);
+
+    for (uint16_t y = y1; y <= y2; y += rows) {
+        const uint8_t *data = buffer + (y - y1) * pitch;
+
+        rows = mipi_display_scroll_run(display, y, y2, &row);
+        mipi_display_set_address(display, x1, row, x2, row + rows - 1);
+
+        if (mipi_display_bounced(display, data)) {
+            mipi_display_queue_bounced(display, data, line, pitch, rows, 0);
+        } else if (line == pitch) {
+            /* Lines are contiguous in memory, send everything at once. */
+            mipi_display_queue(display, 1, data, line * rows, 0);
+        } else {
+            for (uint16_t i = 0; i < rows; i++) {
+                mipi_display_queue(display, 1, data + i * pitch, line, 0);
+            }
+        }
+    }
+    mipi_display_collect(display);
+
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+    mipi_display_stats_flush(display, started);
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
+
+    mipi_display_unlock(display);
+
+    return line * h;
 }
 
+/*
+ * Fills the rectangle with single color. Address window is set once and
+ * the same small pattern buffer is then sent over and over again.
+ */
+size_t
+mipi_display_fill(mipi_display_t *display, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, const uint8_t *color)
+{
+    mipi_display_clip_partial(display, &y1, &h);
+
+    if (0 == w || 0 == h) {
+        return 0;
+    }
+
+    const uint16_t x2 = x1 + w - 1;
+    const uint16_t y2 = y1 + h - 1;
+    const size_t bytes = DISPLAY_DEPTH / 8;
+    const size_t size = w * h * bytes;
+    uint16_t row, rows;
+
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+    int64_t started = esp_timer_get_time();
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
+
+    mipi_display_lock(display);
+
+    /* Previous fill has been collected so pattern is free to change. */
+    for (size_t i = 0; i < MIPI_DISPLAY_PATTERN_SIZE; i += bytes) {
+        memcpy(display->pattern + i, color, bytes);
+    }
+
+    for (uint16_t y = y1; y <= y2; y += rows) {
+        rows = mipi_display_scroll_run(display, y, y2, &row);
+
+        const size_t length = w * rows * bytes;
+        mipi_display_set_address(display, x1, row, x2, row + rows - 1);
+        for (size_t i = 0; i < length; i += MIPI_DISPLAY_PATTERN_SIZE) {
+            mipi_display_queue(display, 1, display->pattern, min(MIPI_DISPLAY_PATTERN_SIZE, length - i), 0);
+        }
+    }
+    mipi_display_collect(display);
+
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+    mipi_display_stats_flush(display, started);
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
+
+    mipi_display_unlock(display);
+
+    return size;
+}
+
+/*
+ * Initializes the display described by config. Each display must be on
+ * its own SPI host or i80 bus since the bus is used exclusively.
+ */
 void
-mipi_display_init(spi_device_handle_t *spi)
+mipi_display_init(mipi_display_t *display, const mipi_display_config_t *config)
 {
-    mutex = xSemaphoreCreateMutex();
+    memset(display, 0, sizeof(mipi_display_t));
+    display->config = *config;
 
-#if CONFIG_MIPI_DISPLAY_PIN_CS > 0
-    /* Setup CS pin */
-    esp_rom_gpio_pad_select_gpio(CONFIG_MIPI_DISPLAY_PIN_CS);
-    gpio_set_direction(CONFIG_MIPI_DISPLAY_PIN_CS, GPIO_MODE_OUTPUT);
-    gpio_set_level(CONFIG_MIPI_DISPLAY_PIN_CS, 0);
-#endif /* CONFIG_MIPI_DISPLAY_PIN_CS > 0 */
+    display->mutex = xSemaphoreCreateBinary();
+    xSemaphoreGive(display->mutex);
 
-    /* Setup DC pin */
-    esp_rom_gpio_pad_select_gpio(CONFIG_MIPI_DISPLAY_PIN_DC);
-    gpio_set_direction(CONFIG_MIPI_DISPLAY_PIN_DC, GPIO_MODE_OUTPUT);
+    /* Nothing is cached before the first address window. */
+    display->prev_x1 = display->prev_x2 = UINT16_MAX;
+    display->prev_y1 = display->prev_y2 = UINT16_MAX;
+    display->partial_y2 = config->height - 1;
 
-    mipi_display_spi_master_init(spi);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+    display->stats.flush_min_us = UINT32_MAX;
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
 
-#if CONFIG_MIPI_DISPLAY_PIN_RST > 0
-    /* Reset the display. */
-    esp_rom_gpio_pad_select_gpio(CONFIG_MIPI_DISPLAY_PIN_RST);
-    gpio_set_direction(CONFIG_MIPI_DISPLAY_PIN_RST, GPIO_MODE_OUTPUT);
-    gpio_set_level(CONFIG_MIPI_DISPLAY_PIN_RST, 0);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    gpio_set_level(CONFIG_MIPI_DISPLAY_PIN_RST, 1);
+    display->pattern = (uint8_t *) heap_caps_malloc(MIPI_DISPLAY_PATTERN_SIZE, MALLOC_CAP_DMA);
+    if (NULL == display->pattern) {
+        ESP_LOGE(TAG, "Failed to alloc fill pattern.");
+    }
+
+    /* Each bounce buffer is sent with one transaction of whole pixels. */
+    display->config.bounce_size = min(config->bounce_size, MIPI_DISPLAY_CHUNK_SIZE) / 12 * 12;
+
+    mipi_display_transport_init(display);
     vTaskDelay(100 / portTICK_PERIOD_MS);
-#endif /* CONFIG_MIPI_DISPLAY_PIN_RST > 0 */
+
+    if (config->pin_rst > 0) {
+        /* Reset the display. */
+        esp_rom_gpio_pad_select_gpio(config->pin_rst);
+        gpio_set_direction(config->pin_rst, GPIO_MODE_OUTPUT);
+        gpio_set_level(config->pin_rst, 0);
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+        gpio_set_level(config->pin_rst, 1);
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+    }
+
+    /* Scroll area math needs all display rows to be in the memory. */
+    if (display->config.gram_height < config->height + config->offset_y) {
+        ESP_LOGW(TAG, "Controller memory height %d is less than display height.", config->gram_height);
+        display->config.gram_height = config->height + config->offset_y;
+    }
 
     /* Send minimal init commands. */
-    mipi_display_write_command(*spi, MIPI_DCS_SOFT_RESET);
+    mipi_display_write_command(display, MIPI_DCS_SOFT_RESET, NULL, 0);
     vTaskDelay(200 / portTICK_PERIOD_MS);
 
-    mipi_display_write_command(*spi, MIPI_DCS_SET_ADDRESS_MODE);
-    mipi_display_write_data(*spi, &(uint8_t) {MIPI_DISPLAY_ADDRESS_MODE}, 1);
+    mipi_display_write_command(display, MIPI_DCS_SET_ADDRESS_MODE, &(uint8_t) {config->address_mode}, 1);
 
-    mipi_display_write_command(*spi, MIPI_DCS_SET_PIXEL_FORMAT);
-    mipi_display_write_data(*spi, &(uint8_t) {CONFIG_MIPI_DISPLAY_PIXEL_FORMAT}, 1);
+    mipi_display_write_command(display, MIPI_DCS_SET_PIXEL_FORMAT, &(uint8_t) {config->pixel_format}, 1);
 
-#ifdef CONFIG_MIPI_DISPLAY_INVERT
-    mipi_display_write_command(*spi, MIPI_DCS_ENTER_INVERT_MODE);
-#else
-    mipi_display_write_command(*spi, MIPI_DCS_EXIT_INVERT_MODE);
-#endif /* CONFIG_MIPI_DISPLAY_INVERT */
+    if (config->invert) {
+        mipi_display_write_command(display, MIPI_DCS_ENTER_INVERT_MODE, NULL, 0);
+    } else {
+        mipi_display_write_command(display, MIPI_DCS_EXIT_INVERT_MODE, NULL, 0);
+    }
 
-    mipi_display_write_command(*spi, MIPI_DCS_EXIT_SLEEP_MODE);
+    mipi_display_write_command(display, MIPI_DCS_EXIT_SLEEP_MODE, NULL, 0);
     vTaskDelay(200 / portTICK_PERIOD_MS);
 
-    mipi_display_write_command(*spi, MIPI_DCS_SET_DISPLAY_ON);
+    mipi_display_write_command(display, MIPI_DCS_SET_DISPLAY_ON, NULL, 0);
     vTaskDelay(200 / portTICK_PERIOD_MS);
 
-#if CONFIG_MIPI_DISPLAY_PIN_BL > 0
-    /* Enable backlight. */
-    ESP_LOGI(TAG, "Enabling backlight pin %d", CONFIG_MIPI_DISPLAY_PIN_BL);
-    esp_rom_gpio_pad_select_gpio(CONFIG_MIPI_DISPLAY_PIN_BL);
-    gpio_set_direction(CONFIG_MIPI_DISPLAY_PIN_BL, GPIO_MODE_OUTPUT);
-    gpio_set_level(CONFIG_MIPI_DISPLAY_PIN_BL, CONFIG_MIPI_DISPLAY_PIN_BL_ACTIVE);
-#endif /* CONFIG_MIPI_DISPLAY_PIN_BL > 0 */
-
-#if CONFIG_MIPI_DISPLAY_PWM_BL > 0
-    /* Enable backlight PWM. */
-    ESP_LOGI(TAG, "Setting backlight PWM to %d", CONFIG_MIPI_DISPLAY_PWM_BL);
-    ledc_timer_config_t timercfg = {
-        .duty_resolution = LEDC_TIMER_13_BIT,
-        .freq_hz = 9765,
-        .speed_mode = LEDC_LOW_SPEED_MODE,
-        .timer_num = LEDC_TIMER_0,
-        .clk_cfg = LEDC_AUTO_CLK,
-    };
-
-    ledc_timer_config(&timercfg);
-
-    ledc_channel_config_t channelcfg = {
-        .channel    = LEDC_CHANNEL_0,
-        .duty       = CONFIG_MIPI_DISPLAY_PWM_BL,
-        .gpio_num   = CONFIG_MIPI_DISPLAY_PIN_BL,
-        .speed_mode = LEDC_LOW_SPEED_MODE,
-        .hpoint     = 0,
-        .timer_sel  = LEDC_TIMER_0,
-    };
-
-    ledc_channel_config(&channelcfg);
-#endif /*  CONFIG_MIPI_DISPLAY_PWM_BL > 0 */
+#ifdef CONFIG_MIPI_DISPLAY_TE_SYNC
+    /* Pulse TE once per frame, at given line or at vertical blanking. */
+    mipi_display_write_command(display, MIPI_DCS_SET_TEAR_ON, &(uint8_t) {0x00}, 1);
+#if CONFIG_MIPI_DISPLAY_TE_SCANLINE > 0
+    mipi_display_write_command(display, MIPI_DCS_SET_TEAR_SCANLINE, (uint8_t[]) {
+        CONFIG_MIPI_DISPLAY_TE_SCANLINE >> 8, CONFIG_MIPI_DISPLAY_TE_SCANLINE & 0xff
+    }, 2);
+#endif /* CONFIG_MIPI_DISPLAY_TE_SCANLINE > 0 */
+
+    if (config->pin_te >= 0) {
+        display->tear = xSemaphoreCreateBinary();
+
+        esp_rom_gpio_pad_select_gpio(config->pin_te);
+        gpio_set_direction(config->pin_te, GPIO_MODE_INPUT);
+        gpio_set_intr_type(config->pin_te, GPIO_INTR_POSEDGE);
+        /* Already installed when there are several displays. */
+        gpio_install_isr_service(0);
+        gpio_isr_handler_add(config->pin_te, mipi_display_te_isr, display);
+    }
+#endif /* CONFIG_MIPI_DISPLAY_TE_SYNC */
+
+    if (config->pin_bl > 0) {
+        /* Enable backlight. */
+        ESP_LOGI(TAG, "Enabling backlight pin %d", config->pin_bl);
+        esp_rom_gpio_pad_select_gpio(config->pin_bl);
+        gpio_set_direction(config->pin_bl, GPIO_MODE_OUTPUT);
+        gpio_set_level(config->pin_bl, config->pin_bl_active);
+    }
+
+    if (config->pin_bl > 0 && config->pwm_bl > 0) {
+        /* Enable backlight PWM. */
+        ESP_LOGI(TAG, "Setting backlight PWM to %d", config->pwm_bl);
+        ledc_timer_config_t timercfg = {
+            .duty_resolution = LEDC_TIMER_13_BIT,
+            .freq_hz = 9765,
+            .speed_mode = LEDC_LOW_SPEED_MODE,
+            .timer_num = LEDC_TIMER_0,
+            .clk_cfg = LEDC_AUTO_CLK,
+        };
+
+        ledc_timer_config(&timercfg);
+
+        ledc_channel_config_t channelcfg = {
+            .channel    = config->pwm_channel,
+            .duty       = config->pwm_bl,
+            .gpio_num   = config->pin_bl,
+            .speed_mode = LEDC_LOW_SPEED_MODE,
+            .hpoint     = 0,
+            .timer_sel  = LEDC_TIMER_0,
+        };
+
+        ledc_channel_config(&channelcfg);
+    }
 
     ESP_LOGI(TAG, "Display initialized.");
+}
+
+#ifdef CONFIG_MIPI_DISPLAY_TE_SYNC
+static void
+mipi_display_scanline_wait(mipi_display_t *display, int64_t period)
+{
+    const int64_t started = esp_timer_get_time();
+    const uint16_t line = CONFIG_MIPI_DISPLAY_TE_SCANLINE;
+    const uint16_t lines = display->config.height;
+    uint16_t previous = line;
+    uint8_t data[2];
+
+    /* Wait for the scan to cross the line, at most two frames. */
+    while (esp_timer_get_time() - started < 2 * period) {
+        mipi_display_ioctl(display, MIPI_DCS_GET_SCANLINE, data, 2);
+
+        uint16_t scanline = (data[0] << 8) | data[1];
+        if (previous < line && scanline >= line) {
+            break;
+        }
+        /* Line zero is passed when scan wraps around. */
+        if (0 == line && scanline < previous) {
+            break;
+        }
+        previous = scanline;
+
+        /*
+         * Release the bus and the CPU between polls. Sleep through half
+         * of the estimated time to the line, porches make it shorter.
+         */
+        const uint16_t distance = (line + lines - scanline % lines) % lines;
+        const TickType_t ticks = pdMS_TO_TICKS(distance * period / lines / 2000);
+        if (ticks) {
+            vTaskDelay(ticks);
+        } else {
+            taskYIELD();
+        }
+    }
+}
+
+static void
+mipi_display_pace(mipi_display_t *display, int64_t period)
+{
+    /* No feedback from the display, keep one frame between flushes. */
+    const int64_t tick = portTICK_PERIOD_MS * 1000;
+    int64_t now = esp_timer_get_time();
+    int64_t next = display->paced_at + period;
+
+    if (now < next) {
+        /* Round up, sleeping a bit too long is better than spinning. */
+        vTaskDelay((next - now + tick - 1) / tick);
+        now = next;
+    }
+    display->paced_at = now;
+}
+#endif /* CONFIG_MIPI_DISPLAY_TE_SYNC */
+
+/*
+ * Waits until it is safe to start sending a new full frame. With TE pin
+ * waits for the next edge, with MISO polls the scanline and otherwise
+ * paces the calls to the refresh rate.
+ */
+void
+mipi_display_vsync_wait(mipi_display_t *display)
+{
+#ifdef CONFIG_MIPI_DISPLAY_TE_SYNC
+    const int64_t period = 1000000 / CONFIG_MIPI_DISPLAY_REFRESH_RATE;
+
+    if (display->config.pin_te >= 0) {
+        /* Ignore an edge which happened before the call. */
+        xSemaphoreTake(display->tear, 0);
+
+        /* Do not hang forever if the display stops sending pulses. */
+        xSemaphoreTake(display->tear, pdMS_TO_TICKS(2 * period / 1000 + 1));
+    } else if (display->config.pin_miso >= 0) {
+        mipi_display_scanline_wait(display, period);
+    } else {
+        mipi_display_pace(display, period);
+    }
+#else
+    (void) display;
+#endif /* CONFIG_MIPI_DISPLAY_TE_SYNC */
+}
+
+/*
+ * Sets the hardware scrolling area in display rows. Rows above and below
+ * the area stay fixed. Height of zero disables scrolling. Areas which do
+ * not fit the display are rejected.
+ */
+esp_err_t
+mipi_display_set_scroll_area(mipi_display_t *display, uint16_t top, uint16_t height)
+{
+    const uint16_t gram_height = display->config.gram_height;
+    uint16_t tfa = 0;
+    uint16_t vsa = gram_height;
+
+    if (height) {
+        /* Display rows start offset_y rows down in controller memory. */
+        tfa = top + display->config.offset_y;
+        vsa = height;
+
+        if (top + height > display->config.height || tfa + vsa > gram_height) {
+            ESP_LOGE(TAG, "Scroll area %d+%d does not fit the display.", top, height);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    /* Disabling makes the whole memory the scrolling area. */
+    const uint16_t bfa = gram_height - tfa - vsa;
 
-    spi_device_acquire_bus(*spi, portMAX_DELAY);
+    if (display->config.address_mode & MIPI_DCS_ADDRESS_MODE_SWAP_XY) {
+        ESP_LOGW(TAG, "Scrolling is horizontal when XY is swapped.");
+    }
+
+    mipi_display_lock(display);
+
+    mipi_display_write_command(display, MIPI_DCS_SET_SCROLL_AREA, (uint8_t[]) {
+        tfa >> 8, tfa & 0xff, vsa >> 8, vsa & 0xff, bfa >> 8, bfa & 0xff
+    }, 6);
+
+    /* Start from the unscrolled position. */
+    mipi_display_write_command(display, MIPI_DCS_SET_SCROLL_START, (uint8_t[]) {tfa >> 8, tfa & 0xff}, 2);
+
+    /* Remapping rows only makes sense when GRAM rows are display rows. */
+    if (display->config.address_mode & MIPI_DCS_ADDRESS_MODE_SWAP_XY) {
+        display->scroll_height = 0;
+    } else {
+        display->scroll_height = height;
+    }
+    display->scroll_top = height ? top : 0;
+    display->scroll_offset = 0;
+
+    mipi_display_unlock(display);
+
+    return ESP_OK;
 }
 
+/*
+ * Scrolls the content of the scrolling area up by offset rows. Later
+ * writes are remapped so that display coordinates stay the same.
+ */
 void
-mipi_display_ioctl(spi_device_handle_t spi, const uint8_t command, uint8_t *data, size_t size)
+mipi_display_set_scroll_offset(mipi_display_t *display, uint16_t offset)
 {
-    xSemaphoreTake(mutex, portMAX_DELAY);
+    mipi_display_lock(display);
+
+    if (display->scroll_height) {
+        offset = offset % display->scroll_height;
+    }
+
+    const uint16_t vsp = display->scroll_top + display->config.offset_y + offset;
+
+    mipi_display_write_command(display, MIPI_DCS_SET_SCROLL_START, (uint8_t[]) {vsp >> 8, vsp & 0xff}, 2);
+    display->scroll_offset = offset;
+
+    mipi_display_unlock(display);
+}
+
+/*
+ * Shows only the given area and optionally reduces colors to save power.
+ * Pixel writes outside the rows of the area are skipped.
+ */
+void
+mipi_display_enter_partial(mipi_display_t *display, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, bool idle)
+{
+    const uint16_t sr = y1 + display->config.offset_y;
+    const uint16_t er = y2 + display->config.offset_y;
+
+    mipi_display_lock(display);
+
+    mipi_display_write_command(display, MIPI_DCS_SET_PARTIAL_ROWS, (uint8_t[]) {
+        sr >> 8, sr & 0xff, er >> 8, er & 0xff
+    }, 4);
+
+    /* Not all controllers support partial columns, skip if not needed. */
+    if (x1 > 0 || x2 < display->config.width - 1) {
+        const uint16_t sc = x1 + display->config.offset_x;
+        const uint16_t ec = x2 + display->config.offset_x;
+
+        mipi_display_write_command(display, MIPI_DCS_SET_PARTIAL_COLUMNS, (uint8_t[]) {
+            sc >> 8, sc & 0xff, ec >> 8, ec & 0xff
+        }, 4);
+    }
+
+    mipi_display_write_command(display, MIPI_DCS_ENTER_PARTIAL_MODE, NULL, 0);
+    mipi_display_write_command(display, idle ? MIPI_DCS_ENTER_IDLE_MODE : MIPI_DCS_EXIT_IDLE_MODE, NULL, 0);
+
+    display->partial_y1 = y1;
+    display->partial_y2 = y2;
+
+    mipi_display_unlock(display);
+}
+
+void
+mipi_display_exit_partial(mipi_display_t *display)
+{
+    mipi_display_lock(display);
+
+    mipi_display_write_command(display, MIPI_DCS_EXIT_IDLE_MODE, NULL, 0);
+    mipi_display_write_command(display, MIPI_DCS_ENTER_NORMAL_MODE, NULL, 0);
+
+    display->partial_y1 = 0;
+    display->partial_y2 = display->config.height - 1;
+
+    mipi_display_unlock(display);
+}
+
+/*
+ * Returns the first and last row currently shown by the display.
+ */
+void
+mipi_display_get_partial(mipi_display_t *display, uint16_t *y1, uint16_t *y2)
+{
+    *y1 = display->partial_y1;
+    *y2 = display->partial_y2;
+}
+
+void
+mipi_display_ioctl(mipi_display_t *display, const uint8_t command, uint8_t *data, size_t size)
+{
+    mipi_display_lock(display);
 
     switch (command) {
         case MIPI_DCS_GET_COMPRESSION_MODE:
@@ -325,19 +912,50 @@ mipi_display_ioctl(spi_device_handle_t spi, const uint8_t command, uint8_t *data
         case MIPI_DCS_GET_POWER_SAVE:
         case MIPI_DCS_READ_DDB_START:
         case MIPI_DCS_READ_DDB_CONTINUE:
-            mipi_display_write_command(spi, command);
-            mipi_display_read_data(spi, data, size);
+            mipi_display_read_command(display, command, data, size);
             break;
         default:
-            mipi_display_write_command(spi, command);
-            mipi_display_write_data(spi, data, size);
+            mipi_display_write_command(display, command, data, size);
     }
 
-    xSemaphoreGive(mutex);
+    mipi_display_unlock(display);
 }
 
 void
-mipi_display_close(spi_device_handle_t spi)
+mipi_display_close(mipi_display_t *display)
 {
-    spi_device_release_bus(spi);
-}
\ No newline at end of file
+#ifdef CONFIG_MIPI_DISPLAY_TE_SYNC
+    if (display->config.pin_te >= 0) {
+        gpio_isr_handler_remove(display->config.pin_te);
+    }
+#endif /* CONFIG_MIPI_DISPLAY_TE_SYNC */
+
+    /* Wait for asynchronous write to finish. */
+    mipi_display_lock(display);
+    mipi_display_unlock(display);
+
+    mipi_display_transport_close(display);
+}
+
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+void
+mipi_display_stats_get(mipi_display_t *display, mipi_display_stats_t *out)
+{
+    xSemaphoreTake(display->mutex, portMAX_DELAY);
+    *out = display->stats;
+    xSemaphoreGive(display->mutex);
+
+    if (0 == out->flushes) {
+        out->flush_min_us = 0;
+    }
+}
+
+void
+mipi_display_stats_reset(mipi_display_t *display)
+{
+    xSemaphoreTake(display->mutex, portMAX_DELAY);
+    memset(&display->stats, 0, sizeof(mipi_display_stats_t));
+    display->stats.flush_min_us = UINT32_MAX;
+    xSemaphoreGive(display->mutex);
+}
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
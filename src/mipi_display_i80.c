@@ -0,0 +1,226 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Intel 8080 parallel bus transport using the LCD peripheral of ESP32-S3
+or the I2S peripheral of ESP32 and ESP32-S2 through the esp_lcd driver.
+Peripheral drives the DC line itself so each command goes out together
+with the parameters or pixel data following it. Pixel data is sent with
+DMA and transfers complete in the order they were queued, so the fence
+of each one is kept in a ring which the transfer done callback advances.
+
+Reading from the panel is not supported by the peripheral.
+
+*/
+
+#include "sdkconfig.h"
+#include "mipi_display.h"
+
+#ifdef CONFIG_MIPI_DISPLAY_TRANSPORT_I80
+
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <driver/gpio.h>
+#include <esp_log.h>
+#include <esp_rom_gpio.h>
+#include <esp_attr.h>
+#include <esp_lcd_panel_io.h>
+
+#include "mipi_dcs.h"
+#include "mipi_display_transport.h"
+
+static const char *TAG = "mipi_display";
+
+static inline int
+min(int a, int b)
+{
+    return (a > b) ? b : a;
+}
+
+static bool IRAM_ATTR
+mipi_display_color_done_cb(esp_lcd_panel_io_handle_t io, esp_lcd_panel_io_event_data_t *event, void *context)
+{
+    mipi_display_t *display = context;
+    const uint32_t fence = display->users[display->tail].fence;
+    BaseType_t woken = pdFALSE;
+
+    (void) io;
+    (void) event;
+
+    display->tail = (display->tail + 1) % MIPI_DISPLAY_QUEUE_SIZE;
+    display->completed++;
+
+    /* Only the last chunk of an asynchronous write carries a fence. */
+    if (fence) {
+        mipi_display_fence_complete(display, fence, &woken);
+    }
+    xSemaphoreGiveFromISR(display->done, &woken);
+
+    return pdTRUE == woken;
+}
+
+void
+mipi_display_wait(mipi_display_t *display, uint32_t sequence)
+{
+    while ((int32_t) (display->completed - sequence) < 0) {
+        xSemaphoreTake(display->done, portMAX_DELAY);
+    }
+}
+
+void
+mipi_display_write_command(mipi_display_t *display, const uint8_t command, const uint8_t *data, size_t length)
+{
+    ESP_LOGD(TAG, "Sending command 0x%02x", command);
+
+    ESP_ERROR_CHECK(esp_lcd_panel_io_tx_param(display->io, command, data, length));
+
+    STATS_ADD(commands, 1);
+    STATS_ADD(data_bytes, length);
+    STATS_ADD(polling_transactions, 1);
+}
+
+void
+mipi_display_read_command(mipi_display_t *display, const uint8_t command, uint8_t *data, size_t length)
+{
+    (void) display;
+    ESP_LOGW(TAG, "Cannot read command 0x%02x from i80 bus.", command);
+    memset(data, 0, length);
+}
+
+/*
+ * Queues the given bytes without waiting. Commands are held back until
+ * the data following them. Parameters are sent right away, esp_lcd copies
+ * them. Pixel data is sent with DMA and if fence is given it is completed
+ * when the last chunk has been sent. Memory writes continue with the
+ * continue command after the first chunk since each transfer toggles CS.
+ */
+void
+mipi_display_queue(mipi_display_t *display, uint8_t dc, const uint8_t *data, size_t length, uint32_t fence)
+{
+    if (0 == dc) {
+        display->command = data[0];
+        STATS_ADD(commands, 1);
+        return;
+    }
+
+    if (MIPI_DCS_WRITE_MEMORY_START != display->command &&
+        MIPI_DCS_WRITE_MEMORY_CONTINUE != display->command) {
+        ESP_ERROR_CHECK(esp_lcd_panel_io_tx_param(display->io, display->command, data, length));
+        STATS_ADD(data_bytes, length);
+        STATS_ADD(polling_transactions, 1);
+        return;
+    }
+
+    for (size_t i = 0; i < length; i += MIPI_DISPLAY_CHUNK_SIZE) {
+        size_t chunk = min(MIPI_DISPLAY_CHUNK_SIZE, length - i);
+        const uint8_t command = display->command;
+
+        /* Ring is full, wait for the oldest transaction to finish. */
+        mipi_display_wait(display, display->sequence - MIPI_DISPLAY_QUEUE_SIZE + 1);
+
+        display->users[display->head].fence = (i + chunk == length) ? fence : 0;
+        display->head = (display->head + 1) % MIPI_DISPLAY_QUEUE_SIZE;
+        display->sequence++;
+        display->command = MIPI_DCS_WRITE_MEMORY_CONTINUE;
+
+        STATS_ADD(queued_transactions, 1);
+        STATS_ADD(data_bytes, chunk);
+
+        /* Book keeping is done first, fenced chunk may release the lock. */
+        ESP_ERROR_CHECK(esp_lcd_panel_io_tx_color(display->io, command, data + i, chunk));
+    }
+}
+
+void
+mipi_display_transport_init(mipi_display_t *display)
+{
+    const mipi_display_config_t *config = &display->config;
+
+    esp_lcd_i80_bus_config_t buscfg = {
+        .clk_src = LCD_CLK_SRC_DEFAULT,
+        .dc_gpio_num = config->pin_dc,
+        .wr_gpio_num = config->pin_wr,
+        .bus_width = config->bus_width,
+        /* DMA descriptors are allocated for this much. */
+        .max_transfer_bytes = MIPI_DISPLAY_CHUNK_SIZE,
+    };
+    esp_lcd_panel_io_i80_config_t iocfg = {
+        .cs_gpio_num = config->pin_cs,
+        .pclk_hz = config->clock_speed_hz,
+        .trans_queue_depth = MIPI_DISPLAY_QUEUE_SIZE,
+        .on_color_trans_done = mipi_display_color_done_cb,
+        .user_ctx = display,
+        .lcd_cmd_bits = 8,
+        .lcd_param_bits = 8,
+        .dc_levels = {
+            .dc_idle_level = 0,
+            .dc_cmd_level = 0,
+            .dc_dummy_level = 0,
+            .dc_data_level = 1,
+        },
+        .flags = {
+            /* Buffer has RGB565 high byte first, 16 bit bus reads it swapped. */
+            .swap_color_bytes = (16 == config->bus_width),
+        },
+    };
+
+    for (uint8_t i = 0; i < config->bus_width; i++) {
+        buscfg.data_gpio_nums[i] = config->pin_data[i];
+    }
+
+    display->done = xSemaphoreCreateBinary();
+
+    if (config->pin_rd >= 0) {
+        /* Reads are not supported, keep the read strobe inactive. */
+        esp_rom_gpio_pad_select_gpio(config->pin_rd);
+        gpio_set_direction(config->pin_rd, GPIO_MODE_OUTPUT);
+        gpio_set_level(config->pin_rd, 1);
+    }
+
+    ESP_ERROR_CHECK(esp_lcd_new_i80_bus(&buscfg, &display->bus));
+    ESP_ERROR_CHECK(esp_lcd_new_panel_io_i80(display->bus, &iocfg, &display->io));
+
+    ESP_LOGI(TAG, "i80 bus width: %d", config->bus_width);
+}
+
+void
+mipi_display_transport_close(mipi_display_t *display)
+{
+    esp_lcd_panel_io_del(display->io);
+    esp_lcd_del_i80_bus(display->bus);
+    vSemaphoreDelete(display->done);
+}
+
+#endif /* CONFIG_MIPI_DISPLAY_TRANSPORT_I80 */
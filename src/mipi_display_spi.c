@@ -0,0 +1,367 @@
+/*
+
+MIT License
+
+Copyright (c) 2017-2018 Espressif Systems (Shanghai) PTE LTD
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+
+-cut-
+
+This code is based on Espressif provided SPI Master example which was
+released to Public Domain: https://goo.gl/ksC2Ln
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+SPI transport. Commands and data are told apart by the DC pin which is
+set in the pre transfer callback. Pixel data is queued to the SPI master
+driver as a ring of transactions and the fence of the last one is
+completed in the post transfer callback. Quad SPI panels without DC pin
+get the command in the address phase of each transaction instead.
+
+*/
+
+#include "sdkconfig.h"
+#include "mipi_display.h"
+
+#ifdef CONFIG_MIPI_DISPLAY_TRANSPORT_SPI
+
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <driver/spi_master.h>
+#include <driver/gpio.h>
+#include <esp_log.h>
+#include <esp_rom_gpio.h>
+#include <esp_attr.h>
+
+#include "mipi_dcs.h"
+#include "mipi_display_transport.h"
+
+static const char *TAG = "mipi_display";
+
+/* QSPI panels take the DCS command in the address phase after these. */
+#define QSPI_OPCODE_WRITE_COMMAND   (0x02)
+#define QSPI_OPCODE_READ_COMMAND    (0x03)
+#define QSPI_OPCODE_WRITE_COLOR     (0x32)
+
+static inline int
+min(int a, int b)
+{
+    return (a > b) ? b : a;
+}
+
+static inline bool
+mipi_display_qspi(mipi_display_t *display)
+{
+    return display->config.pin_quadwp >= 0 && display->config.pin_quadhd >= 0;
+}
+
+static void IRAM_ATTR
+mipi_display_pre_cb(spi_transaction_t *transaction)
+{
+    mipi_display_user_t *user = transaction->user;
+
+    /* DC low denotes a command, high denotes data. QSPI has no DC pin. */
+    if (user->display->config.pin_dc >= 0) {
+        gpio_set_level(user->display->config.pin_dc, user->dc);
+    }
+}
+
+static void IRAM_ATTR
+mipi_display_post_cb(spi_transaction_t *transaction)
+{
+    mipi_display_user_t *user = transaction->user;
+
+    /* Only the last chunk of an asynchronous write carries a fence. */
+    if (user->fence) {
+        BaseType_t woken = pdFALSE;
+
+        mipi_display_fence_complete(user->display, user->fence, &woken);
+        if (pdTRUE == woken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+void
+mipi_display_wait(mipi_display_t *display, uint32_t sequence)
+{
+    spi_transaction_t *transaction;
+
+    /* Results come back in the order transactions were queued. */
+    while ((int32_t) (display->sequence - display->queued - sequence) < 0) {
+        ESP_ERROR_CHECK(spi_device_get_trans_result(display->spi, &transaction, portMAX_DELAY));
+        display->queued--;
+    }
+}
+
+static void
+mipi_display_write_data(mipi_display_t *display, const uint8_t *data, size_t length)
+{
+    if (0 == length) {
+        return;
+    };
+
+    for (size_t i = 0; i < length; i += SPI_MAX_TRANSFER_SIZE) {
+        size_t chunk = min(SPI_MAX_TRANSFER_SIZE, length - i);
+
+        spi_transaction_t transaction = {
+            .length = chunk * 8,
+            .tx_buffer = data + i,
+            .rx_buffer = NULL,
+            .user = &display->data_user,
+        };
+
+        ESP_ERROR_CHECK(spi_device_polling_transmit(display->spi, &transaction));
+        ESP_LOG_BUFFER_HEX_LEVEL(TAG, data + i, chunk, ESP_LOG_VERBOSE);
+
+        STATS_ADD(data_bytes, chunk);
+        STATS_ADD(polling_transactions, 1);
+    }
+}
+
+/*
+ * Sends a command and its parameters. QSPI panels get both in the same
+ * transaction, parameters must then fit in one transfer.
+ */
+void
+mipi_display_write_command(mipi_display_t *display, const uint8_t command, const uint8_t *data, size_t length)
+{
+    ESP_LOGD(TAG, "Sending command 0x%02x", command);
+    STATS_ADD(commands, 1);
+
+    if (mipi_display_qspi(display)) {
+        spi_transaction_t transaction = {
+            .cmd = QSPI_OPCODE_WRITE_COMMAND,
+            .addr = command << 8,
+            .length = length * 8,
+            .tx_buffer = data,
+            .user = &display->data_user,
+        };
+
+        ESP_ERROR_CHECK(spi_device_polling_transmit(display->spi, &transaction));
+
+        STATS_ADD(data_bytes, length);
+        STATS_ADD(polling_transactions, 1);
+        return;
+    }
+
+    spi_transaction_t transaction = {
+        .length = 8,
+        .flags = SPI_TRANS_USE_TXDATA,
+        .tx_data = {command},
+        .user = &display->command_user,
+    };
+
+    ESP_ERROR_CHECK(spi_device_polling_transmit(display->spi, &transaction));
+    STATS_ADD(polling_transactions, 1);
+
+    mipi_display_write_data(display, data, length);
+}
+
+void
+mipi_display_read_command(mipi_display_t *display, const uint8_t command, uint8_t *data, size_t length)
+{
+    if (!mipi_display_qspi(display)) {
+        mipi_display_write_command(display, command, NULL, 0);
+    }
+
+    if (0 == length) {
+        return;
+    };
+
+    spi_transaction_t transaction = {
+        .length = 0, /* no tx */
+        .rxlength = length * 8,/* length in bits */
+        .rx_buffer = data,
+        .user = &display->data_user,
+    };
+
+    if (mipi_display_qspi(display)) {
+        transaction.cmd = QSPI_OPCODE_READ_COMMAND;
+        transaction.addr = command << 8;
+        STATS_ADD(commands, 1);
+    }
+
+    ESP_ERROR_CHECK(spi_device_polling_transmit(display->spi, &transaction));
+
+    STATS_ADD(polling_transactions, 1);
+}
+
+/*
+ * Queues the given bytes without waiting. Short writes are copied to the
+ * transaction itself so the caller does not need to keep them around. If
+ * fence is given it is completed when the last chunk has been sent.
+ *
+ * On QSPI a command is sent later together with the data following it.
+ * Memory writes continue with the continue command after the first chunk
+ * since each transaction starts a new frame.
+ */
+void
+mipi_display_queue(mipi_display_t *display, uint8_t dc, const uint8_t *data, size_t length, uint32_t fence)
+{
+    spi_transaction_t *transaction;
+
+    if (0 == dc && mipi_display_qspi(display)) {
+        display->command = data[0];
+        STATS_ADD(commands, 1);
+        return;
+    }
+
+    for (size_t i = 0; i < length; i += MIPI_DISPLAY_CHUNK_SIZE) {
+        size_t chunk = min(MIPI_DISPLAY_CHUNK_SIZE, length - i);
+
+        /* Ring is full, wait for the oldest transaction to finish. */
+        mipi_display_wait(display, display->sequence - MIPI_DISPLAY_QUEUE_SIZE + 1);
+
+        transaction = &display->transactions[display->head];
+        memset(transaction, 0, sizeof(spi_transaction_t));
+        transaction->length = chunk * 8;
+        if (chunk <= 4) {
+            transaction->flags = SPI_TRANS_USE_TXDATA;
+            memcpy(transaction->tx_data, data + i, chunk);
+        } else {
+            transaction->tx_buffer = data + i;
+        }
+
+        if (mipi_display_qspi(display)) {
+            transaction->addr = display->command << 8;
+            if (MIPI_DCS_WRITE_MEMORY_START == display->command ||
+                MIPI_DCS_WRITE_MEMORY_CONTINUE == display->command) {
+                transaction->cmd = QSPI_OPCODE_WRITE_COLOR;
+                transaction->flags |= SPI_TRANS_MODE_QIO;
+                display->command = MIPI_DCS_WRITE_MEMORY_CONTINUE;
+            } else {
+                transaction->cmd = QSPI_OPCODE_WRITE_COMMAND;
+            }
+        }
+
+        display->users[display->head].dc = dc;
+        display->users[display->head].fence = (i + chunk == length) ? fence : 0;
+        transaction->user = &display->users[display->head];
+
+        display->head = (display->head + 1) % MIPI_DISPLAY_QUEUE_SIZE;
+        display->queued++;
+        display->sequence++;
+
+        STATS_ADD(queued_transactions, 1);
+        if (dc) {
+            STATS_ADD(data_bytes, chunk);
+        } else {
+            STATS_ADD(commands, chunk);
+        }
+
+        /* Book keeping is done first, fenced chunk may release the lock. */
+        ESP_ERROR_CHECK(spi_device_queue_trans(display->spi, transaction, portMAX_DELAY));
+    }
+}
+
+static void
+mipi_display_spi_master_init(mipi_display_t *display)
+{
+    const mipi_display_config_t *config = &display->config;
+
+    spi_bus_config_t buscfg = {
+        .miso_io_num = config->pin_miso,
+        .mosi_io_num = config->pin_mosi,
+        .sclk_io_num = config->pin_clk,
+        .quadwp_io_num = config->pin_quadwp,
+        .quadhd_io_num = config->pin_quadhd,
+        /* Max transfer size in bytes. */
+        .max_transfer_sz = SPI_MAX_TRANSFER_SIZE,
+        .flags = 0
+    };
+    spi_device_interface_config_t devcfg = {
+        .clock_speed_hz = config->clock_speed_hz,
+        .mode = config->spi_mode,
+        .spics_io_num = config->pin_cs,
+        .queue_size = MIPI_DISPLAY_QUEUE_SIZE,
+        .flags = SPI_DEVICE_NO_DUMMY,
+        .pre_cb = mipi_display_pre_cb,
+        .post_cb = mipi_display_post_cb
+    };
+
+    if (mipi_display_qspi(display)) {
+        /* Opcode and 24 bit address carrying the command precede data. */
+        buscfg.flags = SPICOMMON_BUSFLAG_QUAD;
+        devcfg.command_bits = 8;
+        devcfg.address_bits = 24;
+        /* Four line data works only in half duplex mode. */
+        devcfg.flags |= SPI_DEVICE_HALFDUPLEX;
+    }
+
+    /* ESP32S2 requires DMA channel to match the SPI host. */
+    ESP_ERROR_CHECK(spi_bus_initialize(config->host, &buscfg, SPI_DMA_CH_AUTO));
+    ESP_ERROR_CHECK(spi_bus_add_device(config->host, &devcfg, &display->spi));
+
+    ESP_LOGI(TAG, "SPI_MAX_TRANSFER_SIZE: %d", SPI_MAX_TRANSFER_SIZE);
+}
+
+void
+mipi_display_transport_init(mipi_display_t *display)
+{
+    const mipi_display_config_t *config = &display->config;
+
+    display->command_user.display = display;
+    display->command_user.dc = 0;
+    display->data_user.display = display;
+    display->data_user.dc = 1;
+    for (size_t i = 0; i < MIPI_DISPLAY_QUEUE_SIZE; i++) {
+        display->users[i].display = display;
+    }
+
+    if (config->pin_cs > 0) {
+        /* Setup CS pin */
+        esp_rom_gpio_pad_select_gpio(config->pin_cs);
+        gpio_set_direction(config->pin_cs, GPIO_MODE_OUTPUT);
+        gpio_set_level(config->pin_cs, 0);
+    }
+
+    if (mipi_display_qspi(display)) {
+        /* Command is sent in the address phase instead. */
+        display->config.pin_dc = -1;
+    } else {
+        /* Setup DC pin */
+        esp_rom_gpio_pad_select_gpio(config->pin_dc);
+        gpio_set_direction(config->pin_dc, GPIO_MODE_OUTPUT);
+    }
+
+    mipi_display_spi_master_init(display);
+
+    /* Bus is used only by this display, polling writes are faster. */
+    spi_device_acquire_bus(display->spi, portMAX_DELAY);
+}
+
+void
+mipi_display_transport_close(mipi_display_t *display)
+{
+    spi_device_release_bus(display->spi);
+}
+
+#endif /* CONFIG_MIPI_DISPLAY_TRANSPORT_SPI */
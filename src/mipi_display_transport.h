@@ -0,0 +1,111 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2025 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+
+-cut-
+
+This file is part of the ESP32 MIPI DCS HAL for HAGL graphics library:
+https://github.com/tuupola/hagl_esp_mipi/
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Interface between the DCS command flow in mipi_display.c and the bus
+the panel is connected to. Exactly one transport is compiled in, either
+SPI or i80 as selected with menuconfig. Transports are private to the
+driver and not part of the public API.
+
+*/
+
+#ifndef _MIPI_DISPLAY_TRANSPORT_H
+#define _MIPI_DISPLAY_TRANSPORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <freertos/FreeRTOS.h>
+
+#include "sdkconfig.h"
+#include "mipi_display.h"
+
+/* Multiple of every pixel size so that chunks never split a pixel. */
+#define MIPI_DISPLAY_CHUNK_SIZE     (SPI_MAX_TRANSFER_SIZE / 12 * 12)
+
+#ifdef CONFIG_MIPI_DISPLAY_STATS
+#define STATS_ADD(field, value) (display->stats.field += (value))
+#else
+#define STATS_ADD(field, value)
+#endif /* CONFIG_MIPI_DISPLAY_STATS */
+
+/**
+ * Set up the bus and the pins of the display
+ *
+ * Called before the display is reset. Polling writes must work after
+ * this returns.
+ */
+void mipi_display_transport_init(mipi_display_t *display);
+
+/**
+ * Release the bus, nothing is in flight when called
+ */
+void mipi_display_transport_close(mipi_display_t *display);
+
+/**
+ * Send a command and its parameters, returns when sent
+ */
+void mipi_display_write_command(mipi_display_t *display, uint8_t command, const uint8_t *data, size_t length);
+
+/**
+ * Send a command and read its response, returns when read
+ */
+void mipi_display_read_command(mipi_display_t *display, uint8_t command, uint8_t *data, size_t length);
+
+/**
+ * Queue a command (dc is zero) or data without waiting
+ *
+ * Data must stay unchanged until sent, except for four bytes or less
+ * which transport copies. Non zero fence is completed with
+ * mipi_display_fence_complete() when the last byte has been sent.
+ * Every transaction queued increments display->sequence.
+ */
+void mipi_display_queue(mipi_display_t *display, uint8_t dc, const uint8_t *data, size_t length, uint32_t fence);
+
+/**
+ * Wait until the first sequence transactions ever queued are done
+ */
+void mipi_display_wait(mipi_display_t *display, uint32_t sequence);
+
+/**
+ * Complete fence from the transfer done interrupt and release the lock
+ */
+void mipi_display_fence_complete(mipi_display_t *display, uint32_t fence, BaseType_t *woken);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _MIPI_DISPLAY_TRANSPORT_H */